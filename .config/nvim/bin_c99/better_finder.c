@@ -1,18 +1,33 @@
+// better_finder.c : fuzzy filter with fzf-style alignment scoring
+// build: cc better_finder.c -O2 -march=native -pthread -o better_finder
+//
+// usage: better_finder [--limit K] [-j N] [--positions] [--stats] <query>
+// Prints the matching stdin lines, best first (ties keep input order);
+// --limit K only the best K. --positions prefixes each line with the byte
+// runs of its best alignment, "start+len,...<TAB>line"; only the printed
+// lines pay for recovering them. Scoring runs on N threads (default:
+// online CPUs), each with its own DP rows, see fuzzrank.h. --stats prints
+// phase timings to stderr.
+//
+// calculate_score() is the quick greedy left-to-right match; it only
+// decides whether a line matches at all. Matching lines are then scored
+// by align_score(), which finds the best placement of the query under the
+// same bonuses (consecutive run, '/' boundary, camelCase) with a two-row
+// dynamic program, so "fb" in "foo/bar" scores the boundary hit even
+// though the greedy pass matched the 'b' somewhere earlier.
+
+#include "fuzzrank.h"
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-// Represents a file path and its calculated score.
-typedef struct {
-  char *item;
-  int score;
-} ResultItem;
-
-// Comparison for qsort (Descending score)
-int compare_results(const void *a, const void *b) {
-  return ((ResultItem *)b)->score - ((ResultItem *)a)->score;
-}
+#define SCORE_MATCH 10
+#define BONUS_CONSECUTIVE 5 // times the length of the run so far
+#define BONUS_BOUNDARY 50
+#define BONUS_CAMEL 30
 
 // Optimized Fuzzy Score function (FZF-style logic)
 int calculate_score(const char *text, const char *query) {
@@ -28,21 +43,22 @@ int calculate_score(const char *text, const char *query) {
   int consecutive_bonus = 0;
 
   while (*t && *q) {
-    if (tolower(*t) == tolower(*q)) {
+    if (tolower((unsigned char)*t) == tolower((unsigned char)*q)) {
       // Base match score
-      score += 10;
+      score += SCORE_MATCH;
 
       // CONSECUTIVE MATCH BONUS
       consecutive_bonus += 1;
-      score += consecutive_bonus * 5;
+      score += consecutive_bonus * BONUS_CONSECUTIVE;
 
       // BOUNDARY BONUS (e.g., match after '/')
       if (last_match && (*t == '/' || *(t - 1) == '/')) {
-        score += 50;
+        score += BONUS_BOUNDARY;
       }
       // CAMELCASE BONUS
-      else if (last_match && islower(*(t - 1)) && isupper(*t)) {
-        score += 30;
+      else if (last_match && islower((unsigned char)*(t - 1)) &&
+               isupper((unsigned char)*t)) {
+        score += BONUS_CAMEL;
       }
 
       last_match = t;
@@ -65,5 +81,284 @@ int calculate_score(const char *text, const char *query) {
   return (score > 0) ? score : 1;
 }
 
-// ... main function (reading from stdin, sorting, printing to stdout) remains
-// similar to the previous example.
+// --- Alignment scorer ---
+
+// Bonus for matching text[j], independent of the rest of the alignment.
+static int position_bonus(const char *text, size_t j) {
+  unsigned char c = (unsigned char)text[j];
+  unsigned char p = j ? (unsigned char)text[j - 1] : '/';
+  if (c == '/' || p == '/')
+    return BONUS_BOUNDARY;
+  if (islower(p) && isupper(c))
+    return BONUS_CAMEL;
+  return 0;
+}
+
+// Two DP rows over the text, reused across lines.
+typedef struct {
+  int *score_prev, *score_cur; // best score with query[i] matched at text[j]
+  int *run_prev, *run_cur;     // length of the consecutive run ending there
+  int *mem;                    // backs all four
+  size_t cap;
+  size_t *lo, *hi; // per query char: earliest and latest feasible column
+  int *trace;      // every row, kept when positions are wanted
+  size_t tcap;
+} Rows;
+
+static int rows_init(Rows *r, size_t m) {
+  *r = (Rows){0};
+  r->lo = malloc(2 * (m ? m : 1) * sizeof(size_t));
+  r->hi = r->lo + m;
+  return r->lo ? 0 : -1;
+}
+
+static void rows_free(Rows *r) {
+  free(r->trace);
+  free(r->mem);
+  free(r->lo);
+}
+
+static int rows_reserve(Rows *r, size_t n) {
+  if (n <= r->cap)
+    return 0;
+  int *p = realloc(r->mem, 4 * n * sizeof(int));
+  if (!p)
+    return -1;
+  r->mem = p;
+  r->score_prev = p;
+  r->score_cur = p + n;
+  r->run_prev = p + 2 * n;
+  r->run_cur = p + 3 * n;
+  r->cap = n;
+  return 0;
+}
+
+static int rows_reserve_trace(Rows *r, size_t cells) {
+  if (cells <= r->tcap)
+    return 0;
+  int *p = realloc(r->trace, 2 * cells * sizeof(int));
+  if (!p)
+    return -1;
+  r->trace = p;
+  r->tcap = cells;
+  return 0;
+}
+
+// Best score over all placements of query (length m) in text (length n):
+// each matched character earns SCORE_MATCH, its position bonus, and
+// BONUS_CONSECUTIVE times the length of the run it extends. Row i holds,
+// for every j, the best alignment of query[0..i] that ends on text[j];
+// a cell either extends the run ending at j-1 or starts a new run after
+// the best cell at or before j-2. Like fzf's v2 matcher, each cell keeps
+// one (score, run) pair, preferring the longer run on equal scores; a
+// lower-scoring prefix with a longer run that would win later is lost,
+// which costs a few points in rare cases and keeps memory linear.
+//
+// Row i only needs columns between the leftmost (greedy forward) and the
+// rightmost (greedy backward) placement of query[i]; on long paths that
+// is usually a small part of the line.
+//
+// With pos != NULL every row is kept (m * n cells instead of two rows) and
+// the matched byte offsets of the winning alignment are stored in pos[m].
+static int align_score(Rows *r, const char *text, size_t n, const char *query,
+                       size_t m, size_t *pos) {
+  if (m == 0 || rows_reserve(r, n) != 0 ||
+      (pos && rows_reserve_trace(r, m * n) != 0))
+    return -1;
+  size_t j = 0;
+  for (size_t i = 0; i < m; i++, j++) {
+    int qc = tolower((unsigned char)query[i]);
+    while (j < n && tolower((unsigned char)text[j]) != qc)
+      j++;
+    if (j == n)
+      return 0;
+    r->lo[i] = j;
+  }
+  j = n;
+  for (size_t i = m; i-- > 0;) {
+    int qc = tolower((unsigned char)query[i]);
+    while (tolower((unsigned char)text[--j]) != qc)
+      ;
+    r->hi[i] = j;
+  }
+
+  const int NONE = INT_MIN / 2;
+  int *ps = r->score_prev, *pr = r->run_prev;
+  int *cs = r->score_cur, *cr = r->run_cur;
+  for (size_t i = 0; i < m; i++) {
+    if (pos) {
+      cs = r->trace + 2 * i * n;
+      cr = cs + n;
+    }
+    int qc = tolower((unsigned char)query[i]);
+    size_t plo = i ? r->lo[i - 1] : 0, phi = i ? r->hi[i - 1] : 0;
+    int gap_best = i == 0 ? 0 : NONE; // best prev-row cell before j-1
+    for (j = plo; i > 0 && j + 1 < r->lo[i] && j <= phi; j++)
+      if (ps[j] > gap_best)
+        gap_best = ps[j];
+    for (j = r->lo[i]; j <= r->hi[i]; j++) {
+      int s = NONE, run = 0;
+      int prev_ok = i > 0 && j - 1 <= phi; // j > lo[i-1] always holds
+      if (tolower((unsigned char)text[j]) == qc) {
+        int base = SCORE_MATCH + position_bonus(text, j);
+        if (gap_best > NONE) {
+          s = gap_best + base + BONUS_CONSECUTIVE;
+          run = 1;
+        }
+        if (prev_ok && ps[j - 1] > NONE) {
+          int k = pr[j - 1] + 1;
+          int c = ps[j - 1] + base + k * BONUS_CONSECUTIVE;
+          if (c >= s) {
+            s = c;
+            run = k;
+          }
+        }
+      }
+      cs[j] = s;
+      cr[j] = run;
+      if (prev_ok && ps[j - 1] > gap_best)
+        gap_best = ps[j - 1];
+    }
+    int *t = ps;
+    ps = cs;
+    cs = t;
+    t = pr;
+    pr = cr;
+    cr = t;
+  }
+  int best = NONE;
+  size_t best_j = 0;
+  for (j = r->lo[m - 1]; j <= r->hi[m - 1]; j++)
+    if (ps[j] > best) {
+      best = ps[j];
+      best_j = j;
+    }
+  if (best == NONE)
+    return 0;
+
+  // Walk back through the kept rows, making the same choices (first
+  // maximum, run > 1 = consecutive) as the forward pass.
+  for (size_t i = m; pos && i-- > 0;) {
+    pos[i] = best_j;
+    if (i == 0)
+      break;
+    const int *prev = r->trace + 2 * (i - 1) * n;
+    const int *run = r->trace + 2 * i * n + n;
+    if (run[best_j] > 1) {
+      best_j--;
+    } else {
+      size_t k = r->lo[i - 1], stop = r->hi[i - 1];
+      if (stop > best_j - 2)
+        stop = best_j - 2;
+      for (size_t c = k + 1; c <= stop; c++)
+        if (prev[c] > prev[k])
+          k = c;
+      best_j = k;
+    }
+  }
+  best -= (int)n; // same length penalty as the greedy scorer
+  return best > 0 ? best : 1;
+}
+
+// --- Ranking ---
+
+typedef struct {
+  const char *text;
+  size_t len;
+  uint64_t mask; // sa_char_mask() of the query
+} Query;
+
+// Per-thread fr_scorer state.
+typedef struct {
+  const Query *q;
+  Rows rows;
+} Scorer;
+
+static void *scorer_new(void *arg) {
+  const Query *q = arg;
+  Scorer *s = malloc(sizeof *s);
+  if (s && rows_init(&s->rows, q->len) != 0) {
+    free(s);
+    s = NULL;
+  }
+  if (s)
+    s->q = q;
+  return s;
+}
+
+static void scorer_free(void *state) {
+  Scorer *s = state;
+  if (s) {
+    rows_free(&s->rows);
+    free(s);
+  }
+}
+
+static int score_line(void *state, const char *line, size_t len) {
+  Scorer *s = state;
+  const Query *q = s ? s->q : NULL;
+  // the mask prefilter already ran in fuzzrank.h (fr_scorer.mask)
+  if (!q || calculate_score(line, q->text) == 0)
+    return -1;
+  if (q->len == 0)
+    return 1000;
+  int score = align_score(&s->rows, line, len, q->text, q->len, NULL);
+  return score > 0 ? score : -1; // -1 here: out of memory for the DP rows
+}
+
+int main(int argc, char *argv[]) {
+  size_t limit = 0; // 0 = every match
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int positions = 0, stats = 0;
+  int argi = 1;
+  for (; argi < argc; argi++) {
+    if (strcmp(argv[argi], "--positions") == 0)
+      positions = 1;
+    else if (strcmp(argv[argi], "--stats") == 0)
+      stats = 1;
+    else if (argi + 1 < argc && strcmp(argv[argi], "--limit") == 0)
+      limit = strtoul(argv[++argi], NULL, 10);
+    else if (argi + 1 < argc && strcmp(argv[argi], "-j") == 0)
+      jobs = strtol(argv[++argi], NULL, 10);
+    else
+      break;
+  }
+  if (argi != argc - 1) {
+    fprintf(stderr,
+            "Usage: %s [--limit K] [-j N] [--positions] [--stats] <query>\n",
+            argv[0]);
+    return 1;
+  }
+  const char *text = argv[argi];
+  Query query = {text, strlen(text), sa_char_mask(text, strlen(text))};
+
+  fr_stats st;
+  uint64_t t0 = fr_now_ns();
+  sa_arena in;
+  if (sa_read_lines(&in, STDIN_FILENO, SA_MASKS) != 0)
+    perror("better_finder: stdin");
+  st.ingest_ns = fr_now_ns() - t0;
+
+  fr_scorer sc = {score_line, scorer_new, scorer_free, &query, query.mask};
+  size_t count = fr_rank_stats(&in, &sc, limit, (int)jobs, &st);
+  if (stats)
+    fr_print_stats(stderr, &st);
+
+  Scorer *tracer = positions ? scorer_new(&query) : NULL;
+  size_t *pos = positions ? malloc((query.len + 1) * sizeof(size_t)) : NULL;
+  for (size_t i = 0; i < count; i++) {
+    const sa_rec *r = &in.recs[i];
+    if (tracer && pos && query.len &&
+        align_score(&tracer->rows, sa_str(&in, r), r->len, query.text,
+                    query.len, pos) > 0)
+      fr_print_runs(stdout, pos, query.len);
+    if (positions)
+      putchar('\t');
+    printf("%s\n", sa_str(&in, r));
+  }
+  free(pos);
+  scorer_free(tracer);
+
+  sa_free(&in);
+  return 0;
+}
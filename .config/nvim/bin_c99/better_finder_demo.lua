@@ -0,0 +1,23 @@
+local M = {}
+
+-- Ranked fuzzy filter: lines come back best first
+function M.find(query, lines, cb)
+  local job = vim.fn.jobstart({"better_finder", query}, {
+    stdin = "pipe",
+    stdout_buffered = true,
+    on_stdout = function(_, data)
+      if data then
+        if data[#data] == "" then table.remove(data) end
+        cb(data)
+      end
+    end,
+  })
+
+  vim.fn.chansend(job, table.concat(lines, "\n") .. "\n")
+  vim.fn.chanclose(job, "stdin")
+end
+
+-- Example usage:
+-- M.find("fb", { "src/foo_bar.c", "foo/bar.c" }, function(r) print(vim.inspect(r)) end)
+
+return M
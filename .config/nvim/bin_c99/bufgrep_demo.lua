@@ -3,6 +3,7 @@ for _, b in ipairs(vim.api.nvim_list_bufs()) do
   local n = vim.api.nvim_buf_get_name(b)
   if vim.fn.filereadable(n) == 1 then table.insert(files, n) end
 end
+if #files == 0 then return end
 local pat = vim.fn.input('Pattern: ')
 vim.fn.setqflist({}, 'r')
 vim.fn.jobstart({'bufgrep', pat, unpack(files)}, {
@@ -2,16 +2,33 @@
 // Usage: ./c_grep "error" *.c
 // Output: JSON lines: {"file":"main.c","line":24,"snippet":"int foo() {\n  if
 // (error) ... \n}\n"}
+//
+// One record per matching function (line = first hit in it); hits outside
+// any function body are reported as a one-line snippet. Function ranges
+// come from a single flexer.h pass, so braces in strings, comments and
+// preprocessor lines do not count.
+//
+// Ranges are cached in a binary index ($C_GREP_INDEX, default
+// $XDG_CACHE_HOME/c_grep.idx; empty disables it), one record per file
+// keyed by the XXH3 hash of its content, so unchanged files are never
+// lexed again.
 
-#define _POSIX_C_SOURCE 200809L
+#define _XOPEN_SOURCE 700
+#define XXH_INLINE_ALL
+#include "flexer.h"
+#include "memscan.h"
+#include "xxhash.h"
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-void json_str(const char *s) {
+// JSON string from a byte slice (snippets are sliced straight from the map)
+void json_strn(const char *s, size_t n) {
   putchar('"');
-  for (; *s; s++) {
+  for (const char *end = s + n; s < end; s++) {
     if (*s == '"' || *s == '\\')
       putchar('\\');
     if (*s == '\n') {
@@ -24,33 +41,361 @@ void json_str(const char *s) {
       putchar('r');
       continue;
     }
+    if (*s == '\t') {
+      putchar('\\');
+      putchar('t');
+      continue;
+    }
     putchar(*s);
   }
   putchar('"');
 }
 
-// Very simple: is this line a function start? (heuristic)
-int is_func_start(const char *line) {
-  // Skip whitespace
-  while (*line && isspace(*line))
-    line++;
-  if (!*line || *line == '/' || *line == '*' || *line == '#')
-    return 0;
-
-  // Look for '(' after a word, and no ';' before it
-  const char *p = line;
-  while (*p && (isalnum(*p) || *p == '_' || *p == '*' || *p == ' '))
-    p++;
-  if (*p != '(')
-    return 0;
-
-  // Ensure no ';' between start and '('
-  const char *semi = strchr(line, ';');
-  const char *paren = strchr(line, '(');
-  if (semi && semi < paren)
-    return 0;
-
-  return 1;
+void json_str(const char *s) { json_strn(s, strlen(s)); }
+
+// --- Function ranges ---
+
+enum {
+  C_LBRACE = TOK_USER,
+  C_RBRACE,
+  C_LPAREN,
+  C_RPAREN,
+  C_SEMI,
+  C_ASSIGN,
+  C_HASH,
+};
+
+static const FlexSymbol c_symbols[] = {
+    {"{", C_LBRACE}, {"}", C_RBRACE}, {"(", C_LPAREN}, {")", C_RPAREN},
+    {";", C_SEMI},   {"=", C_ASSIGN}, {"#", C_HASH},
+    // compound operators, so their '=' is not taken for an initializer
+    {"==", TOK_USER + 100}, {"!=", TOK_USER + 100}, {"<=", TOK_USER + 100},
+    {">=", TOK_USER + 100},
+};
+
+typedef struct {
+  int start, end; // 1-based, inclusive
+} Range;
+
+typedef struct {
+  Range *v;
+  size_t n, cap;
+} Ranges;
+
+static void push_range(Ranges *r, int start, int end) {
+  if (r->n == r->cap) {
+    size_t nc = r->cap ? r->cap * 2 : 64;
+    Range *nv = realloc(r->v, nc * sizeof(Range));
+    if (!nv)
+      return;
+    r->v = nv;
+    r->cap = nc;
+  }
+  r->v[r->n++] = (Range){start, end};
+}
+
+// Preprocessor directive: skip to the end of the logical line.
+static void skip_directive(Flexer *f) {
+  while (!flex_at_end(f)) {
+    char c = flex_advance(f);
+    if (c == '\\' && flex_peek(f) == '\r')
+      flex_advance(f);
+    if (c == '\\' && flex_peek(f) == '\n')
+      flex_advance(f);
+    else if (c == '\n')
+      break;
+  }
+}
+
+static int tok_is(Token t, const char *word) {
+  return t.type == TOK_IDENTIFIER && t.text.len == strlen(word) &&
+         memcmp(t.text.start, word, t.text.len) == 0;
+}
+
+// Single forward pass over the file recording top-level function bodies.
+// A '{' at depth 0 opens a function when the statement so far contains
+// name(...) and no top-level '='; extern "C" / namespace blocks are
+// transparent so the functions inside them are still found.
+static Ranges find_functions(const char *src, size_t len) {
+  Ranges r = {0};
+  Flexer f;
+  flex_init(&f, src, len);
+  f.symbols = c_symbols;
+  f.symbol_count = sizeof(c_symbols) / sizeof(c_symbols[0]);
+  f.line_comment = "//";
+  f.block_comment_start = "/*";
+  f.block_comment_end = "*/";
+
+  int depth = 0, in_func = 0, func_start = 0, transparent = 0;
+  int stmt_line = 0, stmt_toks = 0, paren = 0, call = 0, saw_call = 0;
+  int saw_assign = 0, opens_block = 0, last_line = 0;
+  Token prev = {0};
+#define RESET_STMT()                                                           \
+  (stmt_line = stmt_toks = paren = call = saw_call = saw_assign =             \
+       opens_block = 0)
+
+  Token t;
+  while ((t = flex_next(&f)).type != TOK_EOF) {
+    if (t.type == C_HASH && t.line > last_line) {
+      skip_directive(&f);
+      last_line = f.line - 1;
+      if (depth == 0)
+        RESET_STMT();
+      continue;
+    }
+    last_line = t.line;
+
+    if (depth > 0) {
+      if (t.type == C_LBRACE)
+        depth++;
+      else if (t.type == C_RBRACE && --depth == 0) {
+        if (in_func) {
+          push_range(&r, func_start, t.line);
+          in_func = 0;
+          RESET_STMT();
+        }
+      }
+      prev = t;
+      continue;
+    }
+
+    if (!stmt_line)
+      stmt_line = t.line;
+    if (stmt_toks++ == 0 && (tok_is(t, "namespace") || tok_is(t, "extern")))
+      opens_block = 1;
+    if (opens_block && stmt_toks == 2 && tok_is(prev, "extern") &&
+        t.type != TOK_STRING)
+      opens_block = 0; // plain extern declaration
+
+    switch (t.type) {
+    case C_LPAREN:
+      if (paren++ == 0)
+        call = prev.type == TOK_IDENTIFIER;
+      break;
+    case C_RPAREN:
+      if (paren > 0 && --paren == 0 && call)
+        saw_call = 1;
+      break;
+    case C_ASSIGN:
+      if (paren == 0)
+        saw_assign = 1;
+      break;
+    case C_SEMI:
+      if (paren == 0)
+        RESET_STMT();
+      break;
+    case C_LBRACE:
+      if (opens_block) {
+        transparent++;
+        RESET_STMT();
+        break;
+      }
+      in_func = paren == 0 && saw_call && !saw_assign;
+      func_start = stmt_line;
+      depth = 1;
+      break;
+    case C_RBRACE:
+      if (transparent > 0)
+        transparent--;
+      RESET_STMT();
+      break;
+    }
+    prev = t;
+  }
+#undef RESET_STMT
+  return r;
+}
+
+// Range containing 1-based line ln, or NULL
+static const Range *range_of(const Range *v, size_t n, int ln) {
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (v[mid].start <= ln)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0 || v[lo - 1].end < ln)
+    return NULL;
+  return &v[lo - 1];
+}
+
+// --- Persistent range index ---
+//
+// File layout (native endian, every record 4-byte aligned):
+//   "CGRPIDX1"  u32 count
+//   count * { u64 content_hash; u32 path_len; u32 nranges;
+//             path bytes padded to 4; Range ranges[nranges] }
+
+#define IDX_MAGIC "CGRPIDX1"
+
+typedef struct {
+  const char *path; // NULL = empty slot
+  uint32_t plen;
+  uint32_t n;
+  uint64_t hash;
+  const Range *ranges;
+  int owned; // path and ranges are malloc'd (not in the mapping)
+} IdxRec;
+
+typedef struct {
+  IdxRec *slots;
+  size_t cap, count;
+  int dirty;
+  ms_buf file;
+} Index;
+
+static IdxRec *idx_slot(Index *ix, const char *path, size_t plen) {
+  size_t i = (size_t)XXH3_64bits(path, plen) & (ix->cap - 1);
+  while (ix->slots[i].path && (ix->slots[i].plen != plen ||
+                               memcmp(ix->slots[i].path, path, plen) != 0))
+    i = (i + 1) & (ix->cap - 1);
+  return &ix->slots[i];
+}
+
+static int idx_grow(Index *ix) {
+  Index old = *ix;
+  ix->cap = old.cap ? old.cap * 2 : 256;
+  ix->slots = calloc(ix->cap, sizeof(IdxRec));
+  if (!ix->slots) {
+    *ix = old;
+    return -1;
+  }
+  for (size_t i = 0; i < old.cap; i++)
+    if (old.slots[i].path)
+      *idx_slot(ix, old.slots[i].path, old.slots[i].plen) = old.slots[i];
+  free(old.slots);
+  return 0;
+}
+
+// Insert or replace. On success the index owns ranges; on -1 (out of
+// memory) the caller still does.
+static int idx_put(Index *ix, const char *path, uint64_t hash, Range *ranges,
+                   uint32_t n) {
+  if ((ix->count + 1) * 2 > ix->cap && idx_grow(ix) != 0)
+    return -1;
+  size_t plen = strlen(path);
+  IdxRec *r = idx_slot(ix, path, plen);
+  if (r->path && r->owned) {
+    free((void *)r->ranges);
+    r->ranges = NULL;
+  }
+  if (!r->path || !r->owned) {
+    char *copy = malloc(plen + 1);
+    if (!copy)
+      return -1;
+    memcpy(copy, path, plen + 1);
+    if (!r->path)
+      ix->count++;
+    r->path = copy;
+  }
+  r->plen = (uint32_t)plen;
+  r->hash = hash;
+  r->ranges = ranges;
+  r->n = n;
+  r->owned = 1;
+  ix->dirty = 1;
+  return 0;
+}
+
+static void idx_load(Index *ix, const char *idx_path) {
+  idx_grow(ix);
+  if (ms_map_file(idx_path, &ix->file) != 0)
+    return;
+  const char *p = ix->file.data, *end = p + ix->file.len;
+  uint32_t count;
+  if (ix->file.len < 12 || memcmp(p, IDX_MAGIC, 8) != 0)
+    return; // unknown or truncated: rebuilt on save
+  memcpy(&count, p + 8, 4);
+  p += 12;
+  for (uint32_t k = 0; k < count; k++) {
+    IdxRec r = {0};
+    if (end - p < 16)
+      break;
+    memcpy(&r.hash, p, 8);
+    memcpy(&r.plen, p + 8, 4);
+    memcpy(&r.n, p + 12, 4);
+    p += 16;
+    size_t padded = (r.plen + 3u) & ~(size_t)3;
+    if ((size_t)(end - p) < padded ||
+        (size_t)(end - p - padded) / sizeof(Range) < r.n)
+      break;
+    r.path = p;
+    r.ranges = (const Range *)(p + padded);
+    p += padded + r.n * sizeof(Range);
+    if ((ix->count + 1) * 2 > ix->cap && idx_grow(ix) != 0)
+      break;
+    *idx_slot(ix, r.path, r.plen) = r;
+    ix->count++;
+  }
+}
+
+// Write to a temp file next to the index, then rename over it.
+static void idx_save(Index *ix, const char *idx_path) {
+  if (!ix->dirty)
+    return;
+  char tmp[PATH_MAX + 32];
+  snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", idx_path, (long)getpid());
+  FILE *fp = fopen(tmp, "wb");
+  if (!fp)
+    return;
+  uint32_t count = (uint32_t)ix->count;
+  static const char pad[4] = {0};
+  fwrite(IDX_MAGIC, 1, 8, fp);
+  fwrite(&count, 4, 1, fp);
+  for (size_t i = 0; i < ix->cap; i++) {
+    const IdxRec *r = &ix->slots[i];
+    if (!r->path)
+      continue;
+    fwrite(&r->hash, 8, 1, fp);
+    fwrite(&r->plen, 4, 1, fp);
+    fwrite(&r->n, 4, 1, fp);
+    fwrite(r->path, 1, r->plen, fp);
+    fwrite(pad, 1, ((r->plen + 3u) & ~3u) - r->plen, fp);
+    fwrite(r->ranges, sizeof(Range), r->n, fp);
+  }
+  if (fclose(fp) != 0 || rename(tmp, idx_path) != 0)
+    unlink(tmp);
+}
+
+static void idx_free(Index *ix) {
+  for (size_t i = 0; i < ix->cap; i++) {
+    if (ix->slots[i].path && ix->slots[i].owned) {
+      free((void *)ix->slots[i].path);
+      free((void *)ix->slots[i].ranges);
+    }
+  }
+  free(ix->slots);
+  ms_release(&ix->file);
+}
+
+static const char *default_index_path(char *buf, size_t size) {
+  const char *env = getenv("C_GREP_INDEX");
+  if (env)
+    return *env ? env : NULL;
+  const char *cache = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (cache && *cache)
+    snprintf(buf, size, "%s/c_grep.idx", cache);
+  else if (home && *home)
+    snprintf(buf, size, "%s/.cache/c_grep.idx", home);
+  else
+    return NULL;
+  return buf;
+}
+
+// 0-based line containing byte offset off
+static size_t line_of(const size_t *lines, size_t count, size_t off) {
+  size_t lo = 0, hi = count;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (lines[mid] <= off)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
 }
 
 int main(int argc, char *argv[]) {
@@ -60,73 +405,96 @@ int main(int argc, char *argv[]) {
   }
 
   const char *pattern = argv[1];
+  size_t plen = strlen(pattern);
+  if (plen == 0) { // would match at every offset, the end included
+    fprintf(stderr, "%s: empty pattern\n", argv[0]);
+    return 1;
+  }
+
+  char idx_buf[PATH_MAX];
+  const char *idx_path = default_index_path(idx_buf, sizeof(idx_buf));
+  Index idx = {0};
+  if (idx_path)
+    idx_load(&idx, idx_path);
 
   for (int i = 2; i < argc; i++) {
     const char *filepath = argv[i];
-    FILE *fp = fopen(filepath, "r");
-    if (!fp)
+    ms_buf b;
+    if (ms_map_file(filepath, &b) != 0)
+      continue;
+
+    // Literal scan of the whole mapping first; most files never match,
+    // and those never pay for the line index or the lexer.
+    const char *hit = ms_find(b.data, b.len, pattern, plen);
+    if (!hit || b.len == 0) {
+      ms_release(&b);
       continue;
+    }
 
-    char *lines[10000] = {0}; // store lines (simplified; assume <10k lines)
-    int line_count = 0;
-    char buf[1024];
+    // One SIMD pass: offsets of every line start. Line k spans
+    // [lines[k], lines[k + 1]) including its newline.
+    size_t *lines;
+    size_t line_count = ms_line_index(b.data, b.len, &lines);
+    if (line_count == (size_t)-1) {
+      perror(filepath);
+      ms_release(&b);
+      continue;
+    }
+#define LINE_BEG(k) (b.data + lines[k])
+#define LINE_END(k) (b.data + ((k) + 1 < line_count ? lines[(k) + 1] : b.len))
 
-    while (fgets(buf, sizeof(buf), fp)) {
-      // Store copy
-      size_t len = strlen(buf);
-      char *copy = malloc(len + 1);
-      memcpy(copy, buf, len + 1);
-      lines[line_count++] = copy;
+    // Function ranges: from the index when the content hash still
+    // matches, otherwise one lexer pass (and the index is updated).
+    const Range *fv;
+    size_t fn_count;
+    Ranges fresh = {0};
+    char key[PATH_MAX];
+    if (!realpath(filepath, key))
+      snprintf(key, sizeof(key), "%s", filepath);
+    uint64_t h = XXH3_64bits(b.data, b.len);
+    IdxRec *rec = idx.cap ? idx_slot(&idx, key, strlen(key)) : NULL;
+    if (rec && rec->path && rec->hash == h) {
+      fv = rec->ranges;
+      fn_count = rec->n;
+    } else {
+      fresh = find_functions(b.data, b.len);
+      fv = fresh.v;
+      fn_count = fresh.n;
+      if (idx.cap && idx_put(&idx, key, h, fresh.v, (uint32_t)fresh.n) == 0)
+        fresh.v = NULL; // owned by the index now
     }
-    fclose(fp);
-
-    // Scan for matches
-    for (int j = 0; j < line_count; j++) {
-      if (strstr(lines[j], pattern)) {
-        // Find start of function
-        int start = j;
-        while (start > 0 && !is_func_start(lines[start]))
-          start--;
-
-        // Find end: balance braces
-        int depth = 0;
-        int end = j;
-        for (int k = start; k < line_count; k++) {
-          for (char *p = lines[k]; *p; p++) {
-            if (*p == '{')
-              depth++;
-            else if (*p == '}')
-              depth--;
-          }
-          if (depth == 0 && k > start) {
-            end = k;
-            break;
-          }
-        }
 
-        // Build snippet
-        printf("{");
-        printf("\"file\":");
-        json_str(filepath);
-        printf(",\"line\":%d", j + 1);
-        printf(",\"snippet\":");
-        putchar('"');
-        for (int k = start; k <= end; k++) {
-          char *p = lines[k];
-          while (*p) {
-            if (*p == '"' || *p == '\\')
-              putchar('\\');
-            putchar(*p++);
-          }
-        }
-        printf("\"}\n");
-        break; // one match per file
-      }
+    const char *end = b.data + b.len;
+    while (hit) {
+      size_t j = line_of(lines, line_count, (size_t)(hit - b.data));
+      const Range *fn = range_of(fv, fn_count, (int)j + 1);
+      size_t start = fn ? (size_t)fn->start - 1 : j;
+      size_t last = fn ? (size_t)fn->end - 1 : j;
+
+      // Snippet is a slice of the mapping
+      printf("{");
+      printf("\"file\":");
+      json_str(filepath);
+      printf(",\"line\":%zu", j + 1);
+      printf(",\"snippet\":");
+      json_strn(LINE_BEG(start), (size_t)(LINE_END(last) - LINE_BEG(start)));
+      printf("}\n");
+
+      // next hit after this function (or line)
+      const char *cur = LINE_END(last);
+      hit = cur < end ? ms_find(cur, (size_t)(end - cur), pattern, plen) : NULL;
     }
+#undef LINE_BEG
+#undef LINE_END
+
+    free(fresh.v);
+    free(lines);
+    ms_release(&b);
+  }
 
-    // Free lines
-    for (int j = 0; j < line_count; j++)
-      free(lines[j]);
+  if (idx_path) {
+    idx_save(&idx, idx_path);
+    idx_free(&idx);
   }
   return 0;
 }
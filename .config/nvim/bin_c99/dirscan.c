@@ -1,8 +1,35 @@
+// dirscan.c : directory sizes as a JSON-like array
+// build: cc dirscan.c -O2 -pthread -o dirscan
+//
+// usage: dirscan [--depth N] [-j N] [--cache FILE] [--allocated] [--dedup]
+//                [--top N] <directory_path>
+// One post-order walk computes every subtree size; directories up to N
+// levels below the root (default 1, the immediate children) are printed
+// as their subtree finishes, deepest first, like du.
+//
+// -j N (N > 1) walks with N threads; the output is the same as the
+// serial walk's, see the parallel walker below. Build with -pthread.
+//
+// --cache FILE remembers every directory between runs and only lists
+// the ones whose entries changed, see the size cache below (serial).
+//
+// Sizes are apparent sizes (st_size) by default; --allocated counts the
+// blocks actually allocated (st_blocks), --dedup counts a file with
+// several hard links once. --top N replaces the listing with the N
+// largest directories and files anywhere in the tree. --dedup and --top
+// walk serially and do not reuse the cache.
+
+#define _GNU_SOURCE // d_type, O_DIRECTORY, O_NOFOLLOW
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
-#include <dirent.h>
+#include <time.h>
 #include <unistd.h>
 
 /**
@@ -19,40 +46,48 @@ int is_directory(const char *path) {
 }
 
 /**
- * Calculate directory size recursively
- * @param path Directory path to calculate size for
- * @return Size in bytes
+ * One of the largest entries seen by --top
  */
-off_t get_directory_size(const char *path) {
-    DIR *dir;
-    struct dirent *entry;
-    struct stat statbuf;
-    off_t size = 0;
-    char full_path[1024];
-    
-    dir = opendir(path);
-    if (dir == NULL) {
-        return 0;
-    }
-    
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
+typedef struct {
+    off_t size;
+    char *path;
+    int is_dir;
+} TopItem;
+
+/**
+ * Walk state: the path of the directory being listed, grown in place
+ */
+typedef struct {
+    char *path;
+    size_t len, cap;
+    int max_depth;   // deepest level that is reported (root = 0)
+    int first;       // no entry printed yet (comma handling)
+    TopItem *top;    // --top: min-heap of the largest entries so far
+    size_t ntop, top_max;
+} Scan;
+
+/**
+ * Append "/name" to the walk path
+ * @return 0 on success, -1 if out of memory
+ */
+static int path_push(Scan *s, const char *name) {
+    size_t nl = strlen(name);
+    if (s->len + nl + 2 > s->cap) {
+        size_t cap = s->cap ? s->cap : 256;
+        while (cap < s->len + nl + 2) {
+            cap *= 2;
         }
-        
-        snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-        
-        if (stat(full_path, &statbuf) == 0) {
-            if (S_ISDIR(statbuf.st_mode)) {
-                size += get_directory_size(full_path);  // Recursive call
-            } else {
-                size += statbuf.st_size;
-            }
+        char *p = realloc(s->path, cap);
+        if (p == NULL) {
+            return -1;
         }
+        s->path = p;
+        s->cap = cap;
     }
-    
-    closedir(dir);
-    return size;
+    s->path[s->len++] = '/';
+    memcpy(s->path + s->len, name, nl + 1);
+    s->len += nl;
+    return 0;
 }
 
 /**
@@ -78,65 +113,1038 @@ const char* format_size(off_t size) {
 }
 
 /**
- * Scan directory and list all subdirectories with sizes
- * @param dirpath Directory path to scan
+ * Print a string as a JSON string literal
+ */
+static void print_json_string(const char *str) {
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            printf("\\%c", *p);
+        } else if (*p < 0x20) {
+            printf("\\u%04x", *p);
+        } else {
+            putchar(*p);
+        }
+    }
+    putchar('"');
+}
+
+/**
+ * Print one directory record
+ * @param s Walk state, s->path is the directory
+ * @param size Its subtree size
+ */
+static void report(Scan *s, off_t size) {
+    // Add comma before entries (except first)
+    if (!s->first) {
+        printf(",\n");
+    }
+    s->first = 0;
+
+    // Print in key-value format (JSON-like)
+    printf("  {\n");
+    printf("    \"location\": ");
+    print_json_string(s->path);
+    printf(",\n");
+    printf("    \"folder_size\": \"%s\"\n", format_size(size));
+    printf("  }");
+}
+
+/* ============================
+      ACCOUNTING
+   ============================ */
+
+/**
+ * (dev, ino) of the multiply-linked files counted so far, for --dedup;
+ * open addressing, ino 0 = empty slot
+ */
+typedef struct {
+    uint64_t (*keys)[2];
+    size_t n, cap;
+} InoSet;
+
+static struct {
+    int allocated;  // st_blocks instead of st_size
+    int dedup;      // count each hard-linked inode once
+    InoSet seen;
+} sizing;
+
+/**
+ * Add a (dev, ino) pair to the set
+ * @return 1 if it was new, 0 if it was there already (or out of memory)
+ */
+static int inoset_add(InoSet *set, uint64_t dev, uint64_t ino) {
+    if (2 * (set->n + 1) > set->cap) {
+        size_t cap = set->cap ? set->cap * 2 : 1024;
+        uint64_t (*keys)[2] = calloc(cap, sizeof(*keys));
+        if (keys == NULL) {
+            return 0;
+        }
+        for (size_t i = 0; i < set->cap; i++) {
+            if (set->keys[i][1] != 0) {
+                size_t j = (size_t)((set->keys[i][1] * 0x9e3779b97f4a7c15ull ^ set->keys[i][0]) & (cap - 1));
+                while (keys[j][1] != 0) {
+                    j = (j + 1) & (cap - 1);
+                }
+                memcpy(keys[j], set->keys[i], sizeof(keys[j]));
+            }
+        }
+        free(set->keys);
+        set->keys = keys;
+        set->cap = cap;
+    }
+    size_t j = (size_t)((ino * 0x9e3779b97f4a7c15ull ^ dev) & (set->cap - 1));
+    while (set->keys[j][1] != 0) {
+        if (set->keys[j][0] == dev && set->keys[j][1] == ino) {
+            return 0;
+        }
+        j = (j + 1) & (set->cap - 1);
+    }
+    set->keys[j][0] = dev;
+    set->keys[j][1] = ino;
+    set->n++;
+    return 1;
+}
+
+/**
+ * Size a non-directory adds to its directory under the current mode
+ * @param st Its lstat
+ */
+static off_t entry_size(const struct stat *st) {
+    if (sizing.dedup && st->st_nlink > 1 && st->st_ino != 0 &&
+        !inoset_add(&sizing.seen, (uint64_t)st->st_dev, (uint64_t)st->st_ino)) {
+        return 0;  // another link was counted already
+    }
+    return sizing.allocated ? (off_t)st->st_blocks * 512 : st->st_size;
+}
+
+/**
+ * Offer an entry to the --top heap
+ * @param s Walk state, s->path names the directory (or the file's directory)
+ * @param name File name inside s->path, or NULL for s->path itself
+ * @param size Its size (subtree size for a directory)
+ */
+static void top_offer(Scan *s, const char *name, off_t size) {
+    TopItem *h = s->top;
+    if (s->ntop == s->top_max && size <= h[0].size) {
+        return;
+    }
+    size_t pl = s->len + (name ? strlen(name) + 1 : 0);
+    char *path = malloc(pl + 1);
+    if (path == NULL) {
+        return;
+    }
+    memcpy(path, s->path, s->len);
+    if (name != NULL) {
+        path[s->len] = '/';
+        memcpy(path + s->len + 1, name, pl - s->len - 1);
+    }
+    path[pl] = '\0';
+    TopItem it = {size, path, name == NULL};
+
+    size_t i;
+    if (s->ntop < s->top_max) {  // sift up from the end
+        i = s->ntop++;
+        while (i > 0 && h[(i - 1) / 2].size > it.size) {
+            h[i] = h[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+    } else {  // replace the smallest, sift down from the root
+        free(h[0].path);
+        i = 0;
+        for (;;) {
+            size_t c = 2 * i + 1;
+            if (c >= s->ntop) {
+                break;
+            }
+            if (c + 1 < s->ntop && h[c + 1].size < h[c].size) {
+                c++;
+            }
+            if (h[c].size >= it.size) {
+                break;
+            }
+            h[i] = h[c];
+            i = c;
+        }
+    }
+    h[i] = it;
+}
+
+/**
+ * Largest first, then by path
+ */
+static int top_cmp(const void *a, const void *b) {
+    const TopItem *x = a, *y = b;
+    if (x->size != y->size) {
+        return x->size > y->size ? -1 : 1;
+    }
+    return strcmp(x->path, y->path);
+}
+
+/**
+ * Print the --top entries, largest first, and free them
+ */
+static void print_top(Scan *s) {
+    qsort(s->top, s->ntop, sizeof(TopItem), top_cmp);
+    for (size_t i = 0; i < s->ntop; i++) {
+        printf("%s  {\n", i ? ",\n" : "");
+        printf("    \"location\": ");
+        print_json_string(s->top[i].path);
+        printf(",\n");
+        printf("    \"type\": \"%s\",\n", s->top[i].is_dir ? "directory" : "file");
+        printf("    \"size\": \"%s\"\n", format_size(s->top[i].size));
+        printf("  }");
+        free(s->top[i].path);
+    }
+    s->ntop = 0;
+}
+
+/**
+ * Look at one directory entry, relative to the directory fd
+ *
+ * d_type tells directories apart without a stat, anything else gets one
+ * fstatat() and its size (see entry_size()) is added to *size. Symlinks
+ * are not followed.
+ *
+ * @param dir Directory being read
+ * @param entry Entry returned by readdir()
+ * @param size Running total of the file sizes in dir
+ * @return fd of the subdirectory opened with openat(), -1 if the entry
+ *         is not a directory, or -2 if it could not be looked at (stat or
+ *         open failed)
+ */
+static int open_entry(DIR *dir, const struct dirent *entry, off_t *size) {
+    const char *name = entry->d_name;
+    // Skip current directory (.) and parent (..)
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        return -1;
+    }
+
+    if (entry->d_type != DT_DIR) {
+        struct stat st;
+        if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return -2;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            *size += entry_size(&st);
+            return -1;
+        }
+    }
+    int fd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    return fd >= 0 ? fd : -2;
+}
+
+/**
+ * Post-order walk of one directory
+ *
+ * Subdirectories are walked before their total is added here, and
+ * reported as soon as they are done.
+ *
+ * @param s Walk state, s->path names the directory
+ * @param dfd Open directory fd, closed on return
+ * @param depth Level of this directory below the root
+ * @return Total size of the files below it, in bytes
  */
-void scan_directories(const char *dirpath) {
-    DIR *dir;
+off_t scan_tree(Scan *s, int dfd, int depth) {
+    DIR *dir = fdopendir(dfd);
+    if (dir == NULL) {
+        close(dfd);
+        return 0;
+    }
+
+    off_t size = 0;
     struct dirent *entry;
-    
-    // Open directory
-    dir = opendir(dirpath);
+    while ((entry = readdir(dir)) != NULL) {
+        off_t before = size;
+        int cfd = open_entry(dir, entry, &size);
+        if (cfd < 0) {
+            if (s->top_max && size > before) {  // a file was counted
+                top_offer(s, entry->d_name, size - before);
+            }
+            continue;
+        }
+        size_t saved = s->len;
+        if (path_push(s, entry->d_name) != 0) {
+            close(cfd);
+            continue;
+        }
+        off_t sub = scan_tree(s, cfd, depth + 1);
+        if (s->top_max) {
+            top_offer(s, NULL, sub);
+        } else if (depth + 1 <= s->max_depth) {
+            report(s, sub);
+        }
+        s->len = saved;
+        s->path[saved] = '\0';
+        size += sub;
+    }
+
+    closedir(dir);
+    return size;
+}
+
+/* ============================
+      PARALLEL WALK
+   ============================
+
+   Every worker owns a deque of opened directories. It lists them newest
+   first and pushes the subdirectories it finds onto its own deque; a
+   worker with nothing left steals the oldest entry of another one, which
+   tends to be near the root and so brings a large subtree with it.
+
+   Directories up to max_depth get a Node, linked to their parent in
+   readdir order by the one worker listing the parent. Deeper directories
+   add their file sizes to their ancestor at max_depth with an atomic add,
+   so memory stays proportional to the reported tree. Once the walk is
+   over, emit() goes through the nodes in the order the serial walk would
+   have visited them and prints the same records. */
+
+#define WALK_MAX_PENDING 512 // queued directory fds; past this, walk inline
+
+typedef struct Node {
+    struct Node **kids;
+    size_t nkids, kcap;
+    off_t size;  // files directly inside (and below, at max_depth)
+    char name[];
+} Node;
+
+typedef struct {
+    int fd;
+    int depth;
+    Node *node;  // its own Node, or the ancestor at max_depth
+} Task;
+
+typedef struct {
+    pthread_mutex_t mu;
+    Task *v;
+    size_t head, tail, cap;  // owner works at tail, thieves take from head
+} Deque;
+
+typedef struct {
+    Deque *dq;
+    int nworkers;
+    int max_depth;
+    size_t pending;  // tasks queued or being listed (atomic)
+    unsigned seq;    // bumped on every push (atomic)
+    int sleepers;    // workers waiting on idle_cv (atomic)
+    pthread_mutex_t idle_mu;
+    pthread_cond_t idle_cv;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int id;
+} Worker;
+
+static Node *node_new(const char *name) {
+    size_t nl = strlen(name);
+    Node *n = malloc(sizeof(Node) + nl + 1);
+    if (n != NULL) {
+        n->kids = NULL;
+        n->nkids = n->kcap = 0;
+        n->size = 0;
+        memcpy(n->name, name, nl + 1);
+    }
+    return n;
+}
+
+static int node_add(Node *parent, Node *kid) {
+    if (parent->nkids == parent->kcap) {
+        size_t cap = parent->kcap ? parent->kcap * 2 : 8;
+        Node **k = realloc(parent->kids, cap * sizeof(Node *));
+        if (k == NULL) {
+            return -1;
+        }
+        parent->kids = k;
+        parent->kcap = cap;
+    }
+    parent->kids[parent->nkids++] = kid;
+    return 0;
+}
+
+static int deque_push(Deque *d, Task t) {
+    pthread_mutex_lock(&d->mu);
+    if (d->tail == d->cap) {
+        if (d->head > 0) {  // slide down over what was stolen
+            memmove(d->v, d->v + d->head, (d->tail - d->head) * sizeof(Task));
+            d->tail -= d->head;
+            d->head = 0;
+        }
+        if (d->tail == d->cap) {
+            size_t cap = d->cap ? d->cap * 2 : 64;
+            Task *v = realloc(d->v, cap * sizeof(Task));
+            if (v == NULL) {
+                pthread_mutex_unlock(&d->mu);
+                return -1;
+            }
+            d->v = v;
+            d->cap = cap;
+        }
+    }
+    d->v[d->tail++] = t;
+    pthread_mutex_unlock(&d->mu);
+    return 0;
+}
+
+/**
+ * Take a task from a deque
+ * @param steal 1 = oldest (thief), 0 = newest (owner)
+ * @return 1 if *t was filled
+ */
+static int deque_take(Deque *d, Task *t, int steal) {
+    int got = 0;
+    pthread_mutex_lock(&d->mu);
+    if (d->head < d->tail) {
+        *t = steal ? d->v[d->head++] : d->v[--d->tail];
+        if (d->head == d->tail) {
+            d->head = d->tail = 0;
+        }
+        got = 1;
+    }
+    pthread_mutex_unlock(&d->mu);
+    return got;
+}
+
+static void pool_wake(Pool *p) {
+    pthread_mutex_lock(&p->idle_mu);
+    pthread_cond_broadcast(&p->idle_cv);
+    pthread_mutex_unlock(&p->idle_mu);
+}
+
+/**
+ * Queue a directory on a worker's deque
+ * @return 0, or -1 if out of memory (the caller walks it itself)
+ */
+static int pool_push(Pool *p, int id, Task t) {
+    // Counted before anyone can take it, so pending never drops to 0 early
+    __atomic_add_fetch(&p->pending, 1, __ATOMIC_SEQ_CST);
+    if (deque_push(&p->dq[id], t) != 0) {
+        __atomic_sub_fetch(&p->pending, 1, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+    __atomic_add_fetch(&p->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&p->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pool_wake(p);
+    }
+    return 0;
+}
+
+/**
+ * List one directory for the parallel walk
+ * @param w Worker doing it
+ * @param t Directory fd (closed on return), depth and Node
+ */
+static void walk_dir(Worker *w, Task t) {
+    Pool *p = w->pool;
+    DIR *dir = fdopendir(t.fd);
     if (dir == NULL) {
-        perror("Error opening directory");
+        close(t.fd);
         return;
     }
-    
-    // Print header in key-value format
-    printf("[\n");
-    
-    int first = 1;  // Flag to handle comma formatting
-    
-    // Read directory entries
+
+    off_t size = 0;
+    struct dirent *entry;
     while ((entry = readdir(dir)) != NULL) {
-        // Skip current directory (.) and parent (..)
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        int cfd = open_entry(dir, entry, &size);
+        if (cfd < 0) {
             continue;
         }
-        
-        // Build full path
-        char full_path[1024];
-        snprintf(full_path, sizeof(full_path), "%s/%s", dirpath, entry->d_name);
-        
-        // Check if it's a directory
-        if (is_directory(full_path)) {
-            off_t size = get_directory_size(full_path);
-            
-            // Add comma before entries (except first)
-            if (!first) {
-                printf(",\n");
+        Task kid = {cfd, t.depth + 1, t.node};
+        if (kid.depth <= p->max_depth) {
+            kid.node = node_new(entry->d_name);
+            if (kid.node == NULL || node_add(t.node, kid.node) != 0) {
+                free(kid.node);
+                close(cfd);
+                continue;
             }
-            first = 0;
-            
-            // Print in key-value format (JSON-like)
-            printf("  {\n");
-            printf("    \"location\": \"%s\",\n", full_path);
-            printf("    \"folder_size\": \"%s\"\n", format_size(size));
-            printf("  }");
+        }
+        // Too many fds queued already (or no memory): walk it right here
+        if (__atomic_load_n(&p->pending, __ATOMIC_RELAXED) >= WALK_MAX_PENDING ||
+            pool_push(p, w->id, kid) != 0) {
+            walk_dir(w, kid);
         }
     }
-    
-    printf("\n]\n");
+
     closedir(dir);
+    __atomic_add_fetch(&t.node->size, size, __ATOMIC_RELAXED);
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    Pool *p = w->pool;
+    for (;;) {
+        unsigned seq = __atomic_load_n(&p->seq, __ATOMIC_SEQ_CST);
+        Task t;
+        int got = deque_take(&p->dq[w->id], &t, 0);
+        for (int i = 1; !got && i < p->nworkers; i++) {
+            got = deque_take(&p->dq[(w->id + i) % p->nworkers], &t, 1);
+        }
+        if (got) {
+            walk_dir(w, t);
+            if (__atomic_sub_fetch(&p->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+                pool_wake(p);  // that was the last one
+            }
+            continue;
+        }
+
+        // Nothing to take: sleep until a push (seq changes) or the end
+        pthread_mutex_lock(&p->idle_mu);
+        __atomic_add_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+        int done = __atomic_load_n(&p->pending, __ATOMIC_SEQ_CST) == 0;
+        if (!done && __atomic_load_n(&p->seq, __ATOMIC_SEQ_CST) == seq) {
+            pthread_cond_wait(&p->idle_cv, &p->idle_mu);
+        }
+        __atomic_sub_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&p->idle_mu);
+        if (done) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Print the records below a Node in serial walk order, freeing them
+ * @param s Walk state, s->path names n
+ * @param n Node whose subdirectories are printed
+ * @return Total size below n
+ */
+static off_t emit(Scan *s, Node *n) {
+    off_t size = n->size;
+    for (size_t i = 0; i < n->nkids; i++) {
+        Node *kid = n->kids[i];
+        size_t saved = s->len;
+        int pushed = path_push(s, kid->name) == 0;
+        off_t sub = emit(s, kid);
+        if (pushed) {
+            report(s, sub);
+            s->len = saved;
+            s->path[saved] = '\0';
+        }
+        size += sub;
+        free(kid);
+    }
+    free(n->kids);
+    return size;
+}
+
+/**
+ * Walk with several threads, then print like scan_tree()
+ * @param s Walk state, s->path names the root
+ * @param fd Open root directory fd, closed on return
+ * @param jobs Number of worker threads
+ */
+static void scan_parallel(Scan *s, int fd, int jobs) {
+    Pool p = {.nworkers = jobs, .max_depth = s->max_depth};
+    Node *root = node_new("");
+    Worker *w = malloc((size_t)jobs * sizeof(Worker));
+    pthread_t *tids = malloc((size_t)jobs * sizeof(pthread_t));
+    p.dq = calloc((size_t)jobs, sizeof(Deque));
+    if (root == NULL || w == NULL || tids == NULL || p.dq == NULL) {
+        free(root);
+        free(w);
+        free(tids);
+        free(p.dq);
+        scan_tree(s, fd, 0);
+        return;
+    }
+    pthread_mutex_init(&p.idle_mu, NULL);
+    pthread_cond_init(&p.idle_cv, NULL);
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_init(&p.dq[i].mu, NULL);
+        w[i] = (Worker){&p, i};
+    }
+
+    Task t = {fd, 0, root};
+    if (pool_push(&p, 0, t) != 0) {
+        walk_dir(&w[0], t);
+    }
+    int started = 0;
+    for (; started < jobs; started++) {
+        if (pthread_create(&tids[started], NULL, worker_main, &w[started]) != 0) {
+            break;
+        }
+    }
+    if (started == 0) {  // no threads at all: do it here
+        worker_main(&w[0]);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    emit(s, root);
+    free(root);
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_destroy(&p.dq[i].mu);
+        free(p.dq[i].v);
+    }
+    pthread_cond_destroy(&p.idle_cv);
+    pthread_mutex_destroy(&p.idle_mu);
+    free(p.dq);
+    free(tids);
+    free(w);
+}
+
+/* ============================
+      SIZE CACHE
+   ============================
+
+   --cache FILE keeps one record per directory, keyed by (dev, ino): its
+   mtime and ctime, the total size of the files directly inside, and the
+   names of its subdirectories. On the next run a directory whose mtime
+   and ctime are unchanged is not listed again; its file total and
+   subdirectory names come from the record, and only the subdirectories
+   are opened and checked the same way. A rescan of an unchanged tree
+   costs an openat() and an fstat() per directory, nothing per file.
+
+   A subdirectory changing does not touch its parent's mtime, which is
+   why the record keeps the parent's own files rather than its whole
+   subtree. A file changing size in place does not touch it either: that
+   shows up once an entry of its directory is added, removed or renamed.
+   Records of directories modified less than CACHE_RACY_NS before the
+   scan that wrote them are not trusted, since a later change could have
+   kept the same timestamp.
+
+   File layout, native byte order, rewritten as a whole after each scan:
+   CacheHeader, nslots CacheRec (open addressing, ino 0 = empty slot),
+   nkids uint32_t offsets of subdirectory names, names (NUL-terminated).
+   The previous file is mmapped read-only while the new one is built. */
+
+#define CACHE_MAGIC "dscache2"
+#define CACHE_RACY_NS 1000000000LL
+
+typedef struct {
+    char magic[8];
+    uint64_t nslots, nkids, names_len;
+    int64_t started_ns;  // wall clock when the scan that wrote it began
+    int64_t allocated;   // sizes are sizing.allocated ones
+} CacheHeader;
+
+typedef struct {
+    uint64_t dev, ino;
+    int64_t mtime_ns, ctime_ns;
+    int64_t size;          // files directly inside
+    uint32_t kids, nkids;  // its range of the name offsets
+} CacheRec;
+
+typedef struct {
+    // previous scan (hdr == NULL if there is none)
+    void *map;
+    size_t map_len;
+    const CacheHeader *hdr;
+    const CacheRec *slots;
+    const uint32_t *kids;
+    const char *names;
+    // this scan
+    CacheRec *recs;
+    size_t nrecs, rcap;
+    uint32_t *kids_out;
+    size_t nkids, kcap;
+    uint32_t *stack;  // subdirectory names of the directories being walked
+    size_t nstack, scap;
+    char *names_out;
+    size_t names_len, ncap;
+    int64_t started_ns;
+    int failed;  // out of memory: the new cache is not written
+} Cache;
+
+/**
+ * Make room for need elements in a growable array
+ * @return 0 on success, -1 if out of memory
+ */
+static int grow(void *v, size_t *cap, size_t need, size_t elem) {
+    if (need <= *cap) {
+        return 0;
+    }
+    size_t nc = *cap ? *cap : 64;
+    while (nc < need) {
+        nc *= 2;
+    }
+    void *p = realloc(*(void **)v, nc * elem);
+    if (p == NULL) {
+        return -1;
+    }
+    *(void **)v = p;
+    *cap = nc;
+    return 0;
+}
+
+static int64_t ts_ns(struct timespec ts) {
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static size_t cache_slot(uint64_t dev, uint64_t ino, uint64_t nslots) {
+    uint64_t h = (ino ^ (dev << 40) ^ (dev >> 24)) * 0x9e3779b97f4a7c15ull;
+    return (size_t)((h >> 32) & (nslots - 1));
+}
+
+/**
+ * Map the cache written by the previous scan, if it is there and sane
+ * @param c Cache to set up
+ * @param path Cache file
+ */
+static void cache_open(Cache *c, const char *path) {
+    struct timespec now;
+    memset(c, 0, sizeof(*c));
+    clock_gettime(CLOCK_REALTIME, &now);
+    c->started_ns = ts_ns(now);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;  // first run
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+
+    const CacheHeader *h = map;
+    size_t len = (size_t)st.st_size;
+    size_t avail = len - sizeof(CacheHeader);
+    int ok = memcmp(h->magic, CACHE_MAGIC, 8) == 0 && h->allocated == sizing.allocated &&
+             h->nslots > 0 && (h->nslots & (h->nslots - 1)) == 0 &&
+             h->nslots <= avail / sizeof(CacheRec);
+    if (ok) {
+        avail -= h->nslots * sizeof(CacheRec);
+        ok = h->nkids <= avail / sizeof(uint32_t) &&
+             h->names_len == avail - h->nkids * sizeof(uint32_t) &&
+             (h->names_len == 0 || ((const char *)map)[len - 1] == '\0');
+    }
+    if (!ok) {
+        munmap(map, len);
+        return;
+    }
+    c->map = map;
+    c->map_len = len;
+    c->hdr = h;
+    c->slots = (const CacheRec *)(h + 1);
+    c->kids = (const uint32_t *)(c->slots + h->nslots);
+    c->names = (const char *)(c->kids + h->nkids);
+}
+
+/**
+ * Record of a directory in the previous scan
+ * @return The record, or NULL if there is none
+ */
+static const CacheRec *cache_find(const Cache *c, uint64_t dev, uint64_t ino) {
+    if (c->hdr == NULL || ino == 0) {
+        return NULL;
+    }
+    uint64_t mask = c->hdr->nslots - 1;
+    for (size_t i = cache_slot(dev, ino, c->hdr->nslots);; i = (i + 1) & mask) {
+        const CacheRec *r = &c->slots[i];
+        if (r->ino == 0) {
+            return NULL;
+        }
+        if (r->ino == ino && r->dev == dev) {
+            return r;
+        }
+    }
+}
+
+/**
+ * Whether an old record still describes a directory
+ * @param r Record from the previous scan
+ * @param st Current fstat() of the directory
+ */
+static int cache_fresh(const Cache *c, const CacheRec *r, const struct stat *st) {
+    if (r->mtime_ns != ts_ns(st->st_mtim) || r->ctime_ns != ts_ns(st->st_ctim) ||
+        r->mtime_ns > c->hdr->started_ns - CACHE_RACY_NS) {
+        return 0;
+    }
+    // A damaged file must not send us out of the mapping
+    if (r->kids > c->hdr->nkids || r->nkids > c->hdr->nkids - r->kids) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < r->nkids; i++) {
+        if (c->kids[r->kids + i] >= c->hdr->names_len) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Walk one subdirectory for scan_cached() and note its name
+ * @param cfd Open subdirectory fd, closed on return; < 0 if it could not
+ *        be opened (the name is still noted, *whole cleared)
+ * @param name Its name in the directory being walked
+ * @param depth Level of the directory being walked
+ * @param whole Cleared if anything below could not be read
+ * @return Total size below the subdirectory
+ */
+static off_t scan_kid(Scan *s, Cache *c, int cfd, const char *name, int depth,
+                      int *whole);
+
+/**
+ * Post-order walk of one directory, reusing the previous scan where the
+ * directory has not changed; same output as scan_tree()
+ * @param s Walk state, s->path names the directory
+ * @param c Cache being read and rebuilt
+ * @param dfd Open directory fd, closed on return
+ * @param depth Level of this directory below the root
+ * @param whole Cleared if anything at or below it could not be read;
+ *        such a directory gets no record (nor do its ancestors), so the
+ *        next run lists it again instead of trusting a partial result
+ * @return Total size of the files below it, in bytes
+ */
+static off_t scan_cached(Scan *s, Cache *c, int dfd, int depth, int *whole) {
+    struct stat st;
+    if (fstat(dfd, &st) != 0) {
+        close(dfd);
+        *whole = 0;
+        return 0;
+    }
+    CacheRec rec = {st.st_dev, st.st_ino, ts_ns(st.st_mtim), ts_ns(st.st_ctim), 0, 0, 0};
+    size_t base = c->nstack;
+    off_t size = 0;
+    int complete = 1;
+
+    const CacheRec *old = cache_find(c, rec.dev, rec.ino);
+    if (old != NULL && cache_fresh(c, old, &st)) {
+        rec.size = old->size;
+        size = old->size;
+        for (uint32_t i = 0; i < old->nkids; i++) {
+            const char *name = c->names + c->kids[old->kids + i];
+            int cfd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            size += scan_kid(s, c, cfd, name, depth, &complete);
+        }
+        close(dfd);
+    } else {
+        DIR *dir = fdopendir(dfd);
+        if (dir == NULL) {
+            close(dfd);
+            *whole = 0;
+            return 0;
+        }
+        off_t own = 0;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int cfd = open_entry(dir, entry, &own);
+            if (cfd >= 0 || (cfd == -2 && entry->d_type == DT_DIR)) {
+                size += scan_kid(s, c, cfd, entry->d_name, depth, &complete);
+            } else if (cfd == -2) {
+                complete = 0;  // its size is unknown
+            }
+        }
+        closedir(dir);
+        rec.size = own;
+        size += own;
+    }
+
+    // This directory's subdirectory names are the top of the stack now
+    size_t n = c->nstack - base;
+    if (!complete) {
+        *whole = 0;
+    } else if (c->nkids + n > UINT32_MAX ||
+        grow(&c->kids_out, &c->kcap, c->nkids + n, sizeof(uint32_t)) != 0 ||
+        grow(&c->recs, &c->rcap, c->nrecs + 1, sizeof(CacheRec)) != 0) {
+        c->failed = 1;
+    } else {
+        if (n > 0) {
+            memcpy(c->kids_out + c->nkids, c->stack + base, n * sizeof(uint32_t));
+        }
+        rec.kids = (uint32_t)c->nkids;
+        rec.nkids = (uint32_t)n;
+        c->nkids += n;
+        c->recs[c->nrecs++] = rec;
+    }
+    c->nstack = base;
+    return size;
+}
+
+static off_t scan_kid(Scan *s, Cache *c, int cfd, const char *name, int depth,
+                      int *whole) {
+    size_t nl = strlen(name) + 1;
+    if (c->names_len + nl > UINT32_MAX ||
+        grow(&c->names_out, &c->ncap, c->names_len + nl, 1) != 0 ||
+        grow(&c->stack, &c->scap, c->nstack + 1, sizeof(uint32_t)) != 0) {
+        c->failed = 1;
+    } else {
+        memcpy(c->names_out + c->names_len, name, nl);
+        c->stack[c->nstack++] = (uint32_t)c->names_len;
+        c->names_len += nl;
+    }
+    if (cfd < 0) {
+        *whole = 0;
+        return 0;
+    }
+
+    size_t saved = s->len;
+    if (path_push(s, name) != 0) {
+        close(cfd);
+        *whole = 0;
+        return 0;
+    }
+    off_t sub = scan_cached(s, c, cfd, depth + 1, whole);
+    if (depth + 1 <= s->max_depth) {
+        report(s, sub);
+    }
+    s->len = saved;
+    s->path[saved] = '\0';
+    return sub;
+}
+
+/**
+ * Write the records of this scan to path (via a temporary file and
+ * rename(), so a reader never sees half of it)
+ * @return 0 on success, -1 on error (errno set)
+ */
+static int cache_save(const Cache *c, const char *path) {
+    uint64_t nslots = 16;
+    while (nslots < 2 * (uint64_t)c->nrecs) {
+        nslots *= 2;
+    }
+    CacheRec *slots = calloc(nslots, sizeof(CacheRec));
+    size_t tl = strlen(path) + 8;
+    char *tmp = malloc(tl);
+    if (slots == NULL || tmp == NULL) {
+        free(slots);
+        free(tmp);
+        return -1;
+    }
+    for (size_t i = 0; i < c->nrecs; i++) {
+        const CacheRec *r = &c->recs[i];
+        size_t j = cache_slot(r->dev, r->ino, nslots);
+        while (slots[j].ino != 0 && !(slots[j].ino == r->ino && slots[j].dev == r->dev)) {
+            j = (j + 1) & (nslots - 1);
+        }
+        if (r->ino != 0 && slots[j].ino == 0) {  // seen twice (bind mount): keep one
+            slots[j] = *r;
+        }
+    }
+
+    CacheHeader h = {CACHE_MAGIC, nslots, c->nkids, c->names_len, c->started_ns,
+                     sizing.allocated};
+    snprintf(tmp, tl, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    FILE *out = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    int rc = -1;
+    if (out != NULL) {
+        int ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+                 fwrite(slots, sizeof(CacheRec), nslots, out) == nslots &&
+                 (c->nkids == 0 ||
+                  fwrite(c->kids_out, sizeof(uint32_t), c->nkids, out) == c->nkids) &&
+                 (c->names_len == 0 ||
+                  fwrite(c->names_out, 1, c->names_len, out) == c->names_len);
+        if (fclose(out) == 0 && ok && rename(tmp, path) == 0) {
+            rc = 0;
+        }
+    } else if (fd >= 0) {
+        close(fd);
+    }
+    if (rc != 0 && fd >= 0) {
+        unlink(tmp);
+    }
+    free(slots);
+    free(tmp);
+    return rc;
+}
+
+static void cache_close(Cache *c) {
+    if (c->map != NULL) {
+        munmap(c->map, c->map_len);
+    }
+    free(c->recs);
+    free(c->kids_out);
+    free(c->stack);
+    free(c->names_out);
+}
+
+/**
+ * Scan directory and list subdirectories with sizes
+ * @param dirpath Directory path to scan
+ * @param max_depth Deepest level to list (1 = immediate children)
+ * @param jobs Number of threads walking the tree
+ * @param cache_path Size cache to use and update, or NULL
+ * @param top List the largest top entries instead (0 = off)
+ */
+void scan_directories(const char *dirpath, int max_depth, int jobs,
+                      const char *cache_path, size_t top) {
+    int fd = open(dirpath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("Error opening directory");
+        return;
+    }
+
+    Scan s = {.max_depth = max_depth, .first = 1};
+    s.len = strlen(dirpath);
+    s.cap = s.len + 256;
+    s.path = malloc(s.cap);
+    if (s.path == NULL) {
+        close(fd);
+        return;
+    }
+    memcpy(s.path, dirpath, s.len + 1);
+    if (top > 0) {
+        s.top = malloc(top * sizeof(TopItem));
+        s.top_max = s.top ? top : 0;
+    }
+    // Which walk: dedup and --top depend on every file being seen in order
+    int serial = sizing.dedup || s.top_max;
+
+    // Print header in key-value format
+    printf("[\n");
+    if (cache_path != NULL && !serial) {
+        Cache c;
+        cache_open(&c, cache_path);
+        int whole = 1;
+        scan_cached(&s, &c, fd, 0, &whole);
+        if (!c.failed && cache_save(&c, cache_path) != 0) {
+            perror(cache_path);
+        }
+        cache_close(&c);
+    } else if (jobs > 1 && !serial) {
+        scan_parallel(&s, fd, jobs);
+    } else {
+        scan_tree(&s, fd, 0);
+    }
+    if (s.top_max) {
+        print_top(&s);
+    }
+    printf("\n]\n");
+    free(s.top);
+    free(s.path);
+    free(sizing.seen.keys);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <directory_path>\n", argv[0]);
+    int max_depth = 1;
+    int jobs = 1;
+    const char *cache_path = NULL;
+    long top = 0;
+    int argi = 1;
+    for (; argi + 1 < argc; argi++) {
+        if (strcmp(argv[argi], "--allocated") == 0) {
+            sizing.allocated = 1;
+        } else if (strcmp(argv[argi], "--dedup") == 0) {
+            sizing.dedup = 1;
+        } else if (argi + 2 < argc && strcmp(argv[argi], "--depth") == 0) {
+            max_depth = atoi(argv[++argi]);
+        } else if (argi + 2 < argc && strcmp(argv[argi], "-j") == 0) {
+            jobs = atoi(argv[++argi]);
+        } else if (argi + 2 < argc && strcmp(argv[argi], "--cache") == 0) {
+            cache_path = argv[++argi];
+        } else if (argi + 2 < argc && strcmp(argv[argi], "--top") == 0) {
+            top = atol(argv[++argi]);
+        } else {
+            break;
+        }
+    }
+    if (argc != argi + 1 || max_depth < 1 || jobs < 1 || top < 0) {
+        fprintf(stderr,
+                "Usage: %s [--depth N] [-j N] [--cache FILE] [--allocated] [--dedup]\n"
+                "          [--top N] <directory_path>\n",
+                argv[0]);
         return 1;
     }
     
-    const char *dirpath = argv[1];
+    const char *dirpath = argv[argi];
     
     // Validate directory exists
     if (!is_directory(dirpath)) {
@@ -144,7 +1152,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    scan_directories(dirpath);
+    scan_directories(dirpath, max_depth, jobs, cache_path, (size_t)top);
     
     return 0;
 }
@@ -1,61 +1,164 @@
+#define _GNU_SOURCE // d_type, O_DIRECTORY
 #include <dirent.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h> // Needed for stat() function
+#include <sys/stat.h> // Needed for fstatat() function
+#include <unistd.h>
 
-// Maximum path length is often 4096, but 1024 is used for simplicity
-#define MAX_PATH 1024
+// Path of the entry being printed, grown in place as the walk descends
+typedef struct {
+  char *buf;
+  size_t len, cap;
+} Path;
+
+// A directory on the way down from the start, for symlink loop checks
+typedef struct Ancestor {
+  dev_t dev;
+  ino_t ino;
+  const struct Ancestor *up;
+} Ancestor;
 
 // Function prototype
-void walk_directory(const char *path);
+void walk_directory(Path *path, int dfd, const Ancestor *up);
 
 int main() {
   // Start walking from the current directory
-  walk_directory(".");
+  Path path = {0};
+  path.cap = 4096;
+  path.buf = malloc(path.cap);
+  if (!path.buf)
+    return 1;
+  strcpy(path.buf, ".");
+  path.len = 1;
+
+  int fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    perror("opendir failed");
+    free(path.buf);
+    return 0;
+  }
+  walk_directory(&path, fd, NULL);
+  free(path.buf);
   return 0;
 }
 
-void walk_directory(const char *path) {
+// Appends "/name"; returns the old length to pop back to, or -1.
+static long path_push(Path *p, const char *name) {
+  size_t nl = strlen(name), old = p->len;
+  if (old + nl + 2 > p->cap) {
+    size_t cap = p->cap * 2;
+    while (cap < old + nl + 2)
+      cap *= 2;
+    char *nb = realloc(p->buf, cap);
+    if (!nb)
+      return -1;
+    p->buf = nb;
+    p->cap = cap;
+  }
+  p->buf[old] = '/';
+  memcpy(p->buf + old + 1, name, nl + 1);
+  p->len = old + nl + 1;
+  return (long)old;
+}
+
+static void path_pop(Path *p, long old) {
+  p->len = (size_t)old;
+  p->buf[old] = '\0';
+}
+
+// Walks the directory open at dfd (closed on return), whose path is in
+// path. Entries are looked at relative to dfd: d_type says file or
+// directory without a syscall, and only DT_UNKNOWN (some filesystems)
+// and symlinks need an fstatat(). Symlinks are followed as before, but
+// a directory that is already one of its own ancestors is not entered
+// again.
+void walk_directory(Path *path, int dfd, const Ancestor *up) {
   DIR *dir;
   struct dirent *entry;
   struct stat statbuf; // Structure to hold file status information
 
   // 1. Open the directory
-  if ((dir = opendir(path)) == NULL) {
+  if ((dir = fdopendir(dfd)) == NULL) {
     perror("opendir failed");
+    close(dfd);
     return;
   }
+  Ancestor self = {0, 0, up};
+  if (fstat(dfd, &statbuf) == 0) {
+    self.dev = statbuf.st_dev;
+    self.ino = statbuf.st_ino;
+  }
 
   // 2. Loop through entries
   while ((entry = readdir(dir)) != NULL) {
-    char full_path[MAX_PATH];
+    const char *name = entry->d_name;
 
     // Skip the special entries '.' (current directory) and '..' (parent
     // directory)
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
       continue;
+
+    // Get the file type, from d_type when the filesystem provides it
+    unsigned char type = entry->d_type;
+    if (type == DT_UNKNOWN) {
+      if (fstatat(dirfd(dir), name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1) {
+        perror("stat failed");
+        continue;
+      }
+      type = S_ISDIR(statbuf.st_mode)   ? DT_DIR
+             : S_ISREG(statbuf.st_mode) ? DT_REG
+             : S_ISLNK(statbuf.st_mode) ? DT_LNK
+                                        : DT_UNKNOWN;
     }
+    int via_link = type == DT_LNK;
+    if (via_link) { // what it points to decides
+      if (fstatat(dirfd(dir), name, &statbuf, 0) == -1) {
+        perror("stat failed");
+        continue;
+      }
+      type = S_ISDIR(statbuf.st_mode)   ? DT_DIR
+             : S_ISREG(statbuf.st_mode) ? DT_REG
+                                        : DT_UNKNOWN;
+    }
+    if (type != DT_DIR && type != DT_REG)
+      continue;
 
     // Construct the full path for the current entry
-    snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-
-    // Get file status/type (optional but useful for robust checking)
-    if (stat(full_path, &statbuf) == -1) {
-      perror("stat failed");
+    long old = path_push(path, name);
+    if (old == -1) {
+      perror("path");
       continue;
     }
 
     // Check if the entry is a Directory
-    if (S_ISDIR(statbuf.st_mode)) {
-      printf("[DIR]: %s\n", full_path);
+    if (type == DT_DIR) {
+      printf("[DIR]: %s\n", path->buf);
 
-      // 3. RECUSION: Call the function for the subdirectory
-      walk_directory(full_path);
+      // A link back up the tree would recurse until the paths overflow
+      const Ancestor *a = NULL;
+      if (via_link)
+        for (a = &self; a; a = a->up)
+          if (a->dev == statbuf.st_dev && a->ino == statbuf.st_ino)
+            break;
+      if (a) {
+        fprintf(stderr, "symlink loop: %s\n", path->buf);
+      } else {
+        // 3. RECUSION: Call the function for the subdirectory
+        int cfd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (cfd == -1)
+          perror("opendir failed");
+        else
+          walk_directory(path, cfd, &self);
+      }
 
       // Check if the entry is a Regular File
-    } else if (S_ISREG(statbuf.st_mode)) {
-      printf("[FILE]: %s\n", full_path);
+    } else {
+      printf("[FILE]: %s\n", path->buf);
     }
+    path_pop(path, old);
   }
 
   // 4. Close the directory stream
@@ -21,15 +21,21 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-typedef enum { const char *start; size_t len; }
-Str;
+typedef struct {
+  const char *start;
+  size_t len;
+} Str;
 
 typedef enum {
   TOK_EOF = 0,
   TOK_INVALID = -1,
-  TOK_USER = 256 // your token types start here
+  TOK_IDENTIFIER = 1, // emitted by the default identifier rule
+  TOK_NUMBER = 2,     // emitted by the default number rule
+  TOK_STRING = 3,     // emitted by the default string/char rule
+  TOK_USER = 256      // your token types start here
 } TokenBaseType;
 
 typedef struct {
@@ -45,7 +51,7 @@ typedef struct {
   } value;
 } Token;
 
-typedef struct Flexer;
+struct Flexer;
 
 typedef void (*FlexRuleFn)(struct Flexer *f, Token *out);
 
@@ -107,6 +113,12 @@ static inline char flex_peek_next(Flexer *f) {
   return (size_t)(f->cur + 1 - f->src) >= f->len ? 0 : f->cur[1];
 }
 
+// true if the unread input at p starts with s (never reads past the end)
+static inline bool flex_starts_with(Flexer *f, const char *p, const char *s) {
+  size_t n = strlen(s);
+  return (size_t)(f->src + f->len - p) >= n && memcmp(p, s, n) == 0;
+}
+
 static inline char flex_advance(Flexer *f) {
   char c = *f->cur++;
   if (c == '\n') {
@@ -120,9 +132,10 @@ static inline char flex_advance(Flexer *f) {
 
 // ──────────────────────────────────────────────────────
 // Internal: longest-match symbol lookup (trie-like linear scan)
+// Returns the matched length (0 = no symbol) and its type in *type.
 // ──────────────────────────────────────────────────────
-static int lookup_symbol(Flexer *f, const char *start, size_t max_len) {
-  int best_type = 0;
+static size_t lookup_symbol(Flexer *f, const char *start, size_t max_len,
+                            int *type) {
   size_t best_len = 0;
 
   for (size_t i = 0; i < f->symbol_count; ++i) {
@@ -130,15 +143,15 @@ static int lookup_symbol(Flexer *f, const char *start, size_t max_len) {
     size_t len = strlen(p);
     if (len <= max_len && len > best_len && memcmp(start, p, len) == 0) {
       best_len = len;
-      best_type = f->symbols[i].token_type;
+      *type = f->symbols[i].token_type;
     }
   }
   if (best_len > 0) {
-    f->cur = start + best_len; // consume it
-    while ((size_t)(f->cur - f->line_start) > 0 && f->cur[-1] != '\n')
-      f->col++;
+    // the first char was already consumed by flex_advance
+    f->cur = start + best_len;
+    f->col += (int)best_len - 1;
   }
-  return best_type;
+  return best_len;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -235,28 +248,31 @@ static Token flex_next(Flexer *f) {
       continue;
 
     // line comment
-    if (f->line_comment &&
-        memcmp(start, f->line_comment, strlen(f->line_comment)) == 0) {
+    if (f->line_comment && flex_starts_with(f, start, f->line_comment)) {
       while (flex_peek(f) && flex_peek(f) != '\n')
         flex_advance(f);
       continue;
     }
 
     // block comment
-    if (f->block_comment_start && memcmp(start, f->block_comment_start,
-                                         strlen(f->block_comment_start)) == 0) {
+    if (f->block_comment_start &&
+        flex_starts_with(f, start, f->block_comment_start)) {
       const char *end = f->block_comment_end;
       size_t elen = strlen(end);
+      size_t slen = strlen(f->block_comment_start);
       int level = 1;
-      f->cur = start + strlen(f->block_comment_start);
+      f->cur = start + slen;
+      f->col += (int)slen - 1;
       while (level > 0 && !flex_at_end(f)) {
-        if (f->nested_comments && memcmp(f->cur, f->block_comment_start,
-                                         strlen(f->block_comment_start)) == 0) {
+        if (f->nested_comments &&
+            flex_starts_with(f, f->cur, f->block_comment_start)) {
           level++;
-          f->cur += strlen(f->block_comment_start);
-        } else if (memcmp(f->cur, end, elen) == 0) {
+          f->cur += slen;
+          f->col += (int)slen;
+        } else if (flex_starts_with(f, f->cur, end)) {
           level--;
           f->cur += elen;
+          f->col += (int)elen;
         } else {
           flex_advance(f);
         }
@@ -265,12 +281,12 @@ static Token flex_next(Flexer *f) {
     }
 
     // symbols / operators (longest match)
-    int sym_type = lookup_symbol(f, start, f->len - (size_t)(start - f->src));
-    if (sym_type != 0) {
-      return (Token){sym_type ? sym_type : 0,
-                     {start, (size_t)(f->cur - start)},
-                     line,
-                     col};
+    int sym_type = 0;
+    if (lookup_symbol(f, start, f->len - (size_t)(start - f->src),
+                      &sym_type)) {
+      if (sym_type == 0)
+        continue; // token_type 0 = skip
+      return (Token){sym_type, {start, (size_t)(f->cur - start)}, line, col};
     }
 
     // identifiers & keywords
@@ -318,8 +334,7 @@ static Token flex_next(Flexer *f) {
     return (Token){TOK_INVALID, {start, 1}, line, col};
   }
 
-  return (Token){TOK_EOF, {NULL, 0}, f->cur}, f->line, f->col
-};
+  return (Token){TOK_EOF, {f->cur, 0}, f->line, f->col};
 }
 
 #endif // FLEXER_H
@@ -327,14 +342,11 @@ static Token flex_next(Flexer *f) {
 // ─────────────────────────────────────────────────────────────────────────────
 // Example: Tokenizing a tiny Python-like language
 // ─────────────────────────────────────────────────────────────────────────────
-#ifdef FLEXER_IMPLEMENTATION
+#ifdef FLEXER_EXAMPLE
 #include <stdio.h>
 
 enum {
-  TOK_IDENTIFIER = TOK_USER,
-  TOK_NUMBER,
-  TOK_STRING,
-  TOK_DEF,
+  TOK_DEF = TOK_USER,
   TOK_IF,
   TOK_ELSE,
   TOK_RETURN,
@@ -0,0 +1,290 @@
+// fuzzbench.c : benchmark the fuzzy scorers on synthetic path lists
+// build: cc fuzzbench.c -O2 -o fuzzbench
+//
+// usage: fuzzbench --gen N [SEED]
+//        fuzzbench [--sizes 10000,100000,...] [--runs R] [--limit K]
+//                  [-j N] [--bin DIR]
+//
+// --gen writes N synthetic paths to stdout; the same N and SEED always
+// give the same list. Without --gen, a list is generated for every size
+// and each of fzf-lite, fuzzy_finder and better_finder (from DIR, else
+// $PATH) is run over it with --stats for a fixed set of queries. The
+// table shows, per tool/size/query, the best of R runs of each phase in
+// ns per candidate (ingestion, scoring incl. per-thread top-K heaps, final
+// merge/sort) and the tool's peak RSS.
+
+#define _GNU_SOURCE // wait4, mkstemp
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const char *tools[] = {"fzf-lite", "fuzzy_finder", "better_finder"};
+
+// Short, long, boundary-heavy and missing-letter queries.
+static const char *queries[] = {"main", "srcutil", "cfg", "tstspec", "qzxj"};
+
+#define NTOOLS (sizeof(tools) / sizeof(tools[0]))
+#define NQUERIES (sizeof(queries) / sizeof(queries[0]))
+
+// --- Corpus generator ---
+
+static uint64_t rng_state;
+
+static uint64_t rng(void) { // splitmix64
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static unsigned pick(unsigned n) { return (unsigned)(rng() % n); }
+
+static const char *top_dirs[] = {
+    "src",   "lib",    "include", "test",  "tests", "docs",         "vendor",
+    "build", "assets", "tools",   "scripts", "pkg", "node_modules", "internal",
+    "cmd",   "app",    ".config", "third_party"};
+
+static const char *dirs[] = {
+    "core",   "util",    "utils",  "common", "api",      "net",     "io",
+    "ui",     "widgets", "config", "models", "handlers", "parser",  "lexer",
+    "render", "plugin",  "lua",    "nvim",   "server",   "client",  "db",
+    "fs",     "cache",   "spec",   "fixtures", "generated", "detail", "impl",
+    "x86_64", "linux",   "dist",   "esm",    "cjs",      "types",   "mocks"};
+
+static const char *syllables[] = {
+    "ka", "lo", "mi", "ne", "ra", "to", "vi", "zo", "ber", "dan", "fel",
+    "gor", "hin", "jas", "mor", "pel", "qua", "sit", "tur", "wex", "str",
+    "buf", "map", "set", "tab", "win", "key", "log", "opt", "run"};
+
+static const char *exts[] = {".c",  ".h",   ".lua",  ".js", ".ts",  ".json",
+                             ".md", ".py",  ".go",   ".rs", ".txt", ".cpp",
+                             ".hpp", ".toml", ".yml", ".o", ".d.ts", ""};
+
+static void put_word(FILE *out, int camel) {
+  int n = 1 + (int)pick(3);
+  for (int i = 0; i < n; i++) {
+    const char *s = syllables[pick(sizeof(syllables) / sizeof(*syllables))];
+    if (camel && i > 0) {
+      fputc(s[0] - 'a' + 'A', out);
+      s++;
+    }
+    fputs(s, out);
+  }
+}
+
+// 1..9 directories deep (5 most often, 4-6 for well over half of the
+// paths) plus the file name; directory names come from a common-directory
+// vocabulary or made-up words, files in snake_case, kebab-case or
+// camelCase with a weighted extension.
+static void gen_path(FILE *out) {
+  int depth = 1 + (int)pick(4) + (int)pick(4) + (int)pick(3);
+  fputs(top_dirs[pick(sizeof(top_dirs) / sizeof(*top_dirs))], out);
+  for (int d = 1; d < depth; d++) {
+    fputc('/', out);
+    if (pick(10) < 6)
+      fputs(dirs[pick(sizeof(dirs) / sizeof(*dirs))], out);
+    else
+      put_word(out, 0);
+  }
+  fputc('/', out);
+  int style = (int)pick(3), words = 1 + (int)pick(3);
+  for (int w = 0; w < words; w++) {
+    if (w > 0 && style < 2)
+      fputc(style == 0 ? '_' : '-', out);
+    put_word(out, style == 2 && w > 0);
+  }
+  unsigned e = pick(24); // the first six extensions get double weight
+  fputs(exts[e < 18 ? e : e - 18], out);
+  fputc('\n', out);
+}
+
+static void gen_corpus(FILE *out, size_t n, uint64_t seed) {
+  rng_state = seed;
+  for (size_t i = 0; i < n; i++)
+    gen_path(out);
+}
+
+// --- Harness ---
+
+typedef struct {
+  size_t n;
+  unsigned long long ingest_ns, score_ns, select_ns;
+  long rss_kb;
+} Sample;
+
+// Runs one tool over the corpus; 0 and *s filled on success.
+static int run_tool(const char *bin, const char *corpus, const char *query,
+                    const char *limit, const char *jobs, Sample *s) {
+  int pfd[2];
+  if (pipe(pfd) != 0)
+    return -1;
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(pfd[0]);
+    close(pfd[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    int in = open(corpus, O_RDONLY), null = open("/dev/null", O_WRONLY);
+    if (in < 0 || null < 0)
+      _exit(127);
+    dup2(in, STDIN_FILENO);
+    dup2(null, STDOUT_FILENO);
+    dup2(pfd[1], STDERR_FILENO);
+    close(pfd[0]);
+    char *argv[] = {(char *)bin, "--stats", "--limit", (char *)limit, "-j",
+                    (char *)jobs, (char *)query, NULL};
+    execvp(bin, argv);
+    _exit(127);
+  }
+  close(pfd[1]);
+  char buf[4096], drain[512];
+  size_t len = 0;
+  ssize_t r;
+  for (;;) { // keep reading past a full buffer so the child never blocks
+    size_t room = sizeof(buf) - 1 - len;
+    r = read(pfd[0], room ? buf + len : drain, room ? room : sizeof(drain));
+    if (r <= 0)
+      break;
+    if (room)
+      len += (size_t)r;
+  }
+  buf[len] = '\0';
+  close(pfd[0]);
+
+  int status;
+  struct rusage ru;
+  if (wait4(pid, &status, 0, &ru) < 0 || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0)
+    return -1;
+  const char *line = strstr(buf, "stats ");
+  if (!line || sscanf(line,
+                      "stats n=%zu kept=%*u ingest_ns=%llu score_ns=%llu "
+                      "select_ns=%llu",
+                      &s->n, &s->ingest_ns, &s->score_ns, &s->select_ns) != 4)
+    return -1;
+  s->rss_kb = ru.ru_maxrss;
+  return 0;
+}
+
+static double per(unsigned long long ns, size_t n) {
+  return n ? (double)ns / (double)n : 0.0;
+}
+
+int main(int argc, char **argv) {
+  const char *sizes = "10000,100000,1000000,5000000";
+  const char *limit = "50", *jobs = "0", *bindir = NULL;
+  int runs = 3;
+
+  if (argc >= 3 && strcmp(argv[1], "--gen") == 0) {
+    uint64_t seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+    gen_corpus(stdout, strtoull(argv[2], NULL, 10), seed);
+    return fflush(stdout) == 0 ? 0 : 1;
+  }
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--sizes") == 0)
+      sizes = argv[i + 1];
+    else if (strcmp(argv[i], "--runs") == 0)
+      runs = atoi(argv[i + 1]);
+    else if (strcmp(argv[i], "--limit") == 0)
+      limit = argv[i + 1];
+    else if (strcmp(argv[i], "-j") == 0)
+      jobs = argv[i + 1];
+    else if (strcmp(argv[i], "--bin") == 0)
+      bindir = argv[i + 1];
+    else {
+      fprintf(stderr,
+              "usage: fuzzbench --gen N [SEED]\n"
+              "       fuzzbench [--sizes N,N,...] [--runs R] [--limit K] "
+              "[-j N] [--bin DIR]\n");
+      return 1;
+    }
+  }
+  if (runs < 1)
+    runs = 1;
+  if (strcmp(jobs, "0") == 0) { // default: what the tools would pick
+    static char buf[16];
+    snprintf(buf, sizeof(buf), "%ld", sysconf(_SC_NPROCESSORS_ONLN));
+    jobs = buf;
+  }
+
+  char bins[NTOOLS][4096];
+  for (size_t t = 0; t < NTOOLS; t++)
+    snprintf(bins[t], sizeof(bins[t]), "%s%s%s", bindir ? bindir : "",
+             bindir ? "/" : "", tools[t]);
+
+  const char *tmpdir = getenv("TMPDIR");
+  char corpus[4096];
+  snprintf(corpus, sizeof(corpus), "%s/fuzzbench.XXXXXX",
+           tmpdir && *tmpdir ? tmpdir : "/tmp");
+  int fd = mkstemp(corpus);
+  if (fd < 0) {
+    perror(corpus);
+    return 1;
+  }
+  close(fd);
+
+  printf("%-14s %9s %-8s %10s %10s %10s %8s\n", "tool", "size", "query",
+         "ingest", "score", "topk", "rss");
+  printf("%-14s %9s %-8s %10s %10s %10s %8s\n", "", "", "", "ns/cand",
+         "ns/cand", "ns/cand", "MiB");
+  int rc = 0;
+  for (const char *p = sizes; *p;) {
+    size_t n = strtoull(p, NULL, 10);
+    p += strcspn(p, ",");
+    p += *p == ',';
+    FILE *out = fopen(corpus, "w");
+    if (!out) {
+      perror(corpus);
+      rc = 1;
+      break;
+    }
+    gen_corpus(out, n, 1);
+    if (fclose(out) != 0) {
+      perror(corpus);
+      rc = 1;
+      break;
+    }
+
+    for (size_t t = 0; t < NTOOLS; t++) {
+      for (size_t q = 0; q < NQUERIES; q++) {
+        Sample best = {0}, s;
+        int ok = 0;
+        for (int r = 0; r < runs; r++) {
+          if (run_tool(bins[t], corpus, queries[q], limit, jobs, &s) != 0)
+            break;
+          if (!ok++) {
+            best = s;
+            continue;
+          }
+          if (s.ingest_ns < best.ingest_ns)
+            best.ingest_ns = s.ingest_ns;
+          if (s.score_ns < best.score_ns)
+            best.score_ns = s.score_ns;
+          if (s.select_ns < best.select_ns)
+            best.select_ns = s.select_ns;
+          if (s.rss_kb > best.rss_kb)
+            best.rss_kb = s.rss_kb;
+        }
+        if (!ok) {
+          fprintf(stderr, "%s: failed to run or no --stats output\n",
+                  bins[t]);
+          rc = 1;
+          continue;
+        }
+        printf("%-14s %9zu %-8s %10.1f %10.1f %10.2f %8.1f\n", tools[t],
+               best.n, queries[q], per(best.ingest_ns, best.n),
+               per(best.score_ns, best.n), per(best.select_ns, best.n),
+               (double)best.rss_kb / 1024.0);
+        fflush(stdout);
+      }
+    }
+  }
+  unlink(corpus);
+  return rc;
+}
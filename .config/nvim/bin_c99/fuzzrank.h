@@ -0,0 +1,263 @@
+#ifndef FUZZRANK_H
+#define FUZZRANK_H
+
+/*
+    fuzzrank.h — parallel scoring and top-K selection over a str_arena.h
+    record array (single-header)
+
+        fr_scorer sc = {my_score, my_state_new, my_state_free, query};
+        size_t n = fr_rank(&arena, &sc, limit, jobs);
+        // arena.recs[0..n) now holds the matches, best first
+
+    fr_filter() is the same pass without a limit or the sort, on any record
+    array: matches stay in input order, which lets a caller narrow a match
+    set query by query. fr_select() then picks the top K of such a set.
+
+    The records are split into one contiguous chunk per thread. Each thread
+    scores its chunk and compacts the matches to the front of it, as a
+    min-heap of at most K items when a limit is given. The survivors of all
+    chunks are then merged and sorted. Order is (score desc, input order),
+    so the result is the same for every thread count.
+
+    fr_print_runs() writes matched byte positions as "start+len" runs
+    separated by commas ("0+2,7+1"), for highlighting on the caller side.
+
+    fr_rank_stats() is fr_rank() that also times its two phases, scoring
+    (with the per-thread heaps) and the final merge/sort; the tools print
+    these with --stats for fuzzbench.c.
+
+    Scorers return < 0 for "no match". Per-thread scratch (DP rows, ...)
+    comes from state_new/state_free; both may be NULL. A non-zero mask
+    (sa_char_mask() of the query) rejects records whose sa_rec.mask lacks
+    any of its bits before the scorer is called; the arena must then have
+    been read with SA_MASKS.
+
+    All functions are static inline; just include the header and build
+    with -pthread.
+*/
+
+#include "str_arena.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FR_MIN_CHUNK 8192 /* fewer records than this per thread: no threads */
+
+typedef struct {
+  int (*score)(void *state, const char *s, size_t len);
+  void *(*state_new)(void *arg);
+  void (*state_free)(void *state);
+  void *arg;
+  uint64_t mask; /* 0 = no mask prefilter */
+} fr_scorer;
+
+/* Best first: higher score, then earlier line. */
+static inline int fr_better(const sa_rec *x, const sa_rec *y) {
+  return x->score != y->score ? x->score > y->score : x->off < y->off;
+}
+
+static inline int fr_cmp(const void *a, const void *b) {
+  const sa_rec *x = a, *y = b;
+  return fr_better(x, y) ? -1 : fr_better(y, x);
+}
+
+/* Min-heap on fr_better(): the root is the worst item kept so far. */
+static inline void fr_sift_down(sa_rec *h, size_t n, size_t i) {
+  for (;;) {
+    size_t l = 2 * i + 1, w = i;
+    if (l < n && fr_better(&h[w], &h[l]))
+      w = l;
+    if (l + 1 < n && fr_better(&h[w], &h[l + 1]))
+      w = l + 1;
+    if (w == i)
+      return;
+    sa_rec t = h[i];
+    h[i] = h[w];
+    h[w] = t;
+    i = w;
+  }
+}
+
+static inline void fr_sift_up(sa_rec *h, size_t i) {
+  while (i > 0) {
+    size_t p = (i - 1) / 2;
+    if (!fr_better(&h[p], &h[i]))
+      return;
+    sa_rec t = h[i];
+    h[i] = h[p];
+    h[p] = t;
+    i = p;
+  }
+}
+
+/* Offers it to the first *len slots of v; with k > 0 they form a heap of
+   at most k items. Slots must not run ahead of the record being read. */
+static inline void fr_keep(sa_rec *v, size_t *len, size_t k, sa_rec it) {
+  if (k && *len == k) {
+    if (fr_better(&it, &v[0])) {
+      v[0] = it;
+      fr_sift_down(v, *len, 0);
+    }
+    return;
+  }
+  v[*len] = it;
+  if (k)
+    fr_sift_up(v, *len);
+  (*len)++;
+}
+
+typedef struct {
+  const sa_arena *a;
+  const fr_scorer *sc;
+  sa_rec *recs; /* this chunk */
+  size_t n, k;
+  size_t kept; /* out: matches left at recs[0..kept) */
+} fr_chunk;
+
+static inline void *fr_chunk_main(void *arg) {
+  fr_chunk *c = arg;
+  void *state = c->sc->state_new ? c->sc->state_new(c->sc->arg) : c->sc->arg;
+  const uint64_t need = c->sc->mask;
+  size_t len = 0;
+  for (size_t i = 0; i < c->n; i++) {
+    sa_rec it = c->recs[i];
+    if ((it.mask & need) != need)
+      continue;
+    it.score = c->sc->score(state, sa_str(c->a, &it), it.len);
+    if (it.score >= 0)
+      fr_keep(c->recs, &len, c->k, it);
+  }
+  if (c->sc->state_free)
+    c->sc->state_free(state);
+  c->kept = len;
+  return NULL;
+}
+
+/* Scores recs[0..n) with up to jobs threads. Each chunk's matches (its
+   best k if k > 0, as a heap) are moved to the front of recs, chunk by
+   chunk; with k == 0 that is input order. Returns how many there are. */
+static inline size_t fr_score_chunks(const sa_arena *a, sa_rec *recs,
+                                     size_t n, const fr_scorer *sc, size_t k,
+                                     int jobs) {
+  if (jobs < 1)
+    jobs = 1;
+  if ((size_t)jobs > n / FR_MIN_CHUNK)
+    jobs = n / FR_MIN_CHUNK > 0 ? (int)(n / FR_MIN_CHUNK) : 1;
+
+  fr_chunk one, *ch = jobs > 1 ? calloc((size_t)jobs, sizeof(*ch)) : NULL;
+  pthread_t *tids = jobs > 1 ? malloc((size_t)jobs * sizeof(*tids)) : NULL;
+  if (!ch || !tids) {
+    free(ch);
+    free(tids);
+    jobs = 1;
+    ch = &one;
+  }
+  for (int t = 0; t < jobs; t++) {
+    size_t lo = n * (size_t)t / (size_t)jobs;
+    size_t hi = n * (size_t)(t + 1) / (size_t)jobs;
+    ch[t] = (fr_chunk){a, sc, recs + lo, hi - lo, k, 0};
+  }
+
+  int started = 0;
+  if (jobs > 1)
+    for (; started < jobs; started++)
+      if (pthread_create(&tids[started], NULL, fr_chunk_main,
+                         &ch[started]) != 0)
+        break;
+  for (int t = started; t < jobs; t++) /* no threads (left): run here */
+    fr_chunk_main(&ch[t]);
+  for (int t = 0; t < started; t++)
+    pthread_join(tids[t], NULL);
+
+  /* Chunks are in input order, so moving each one's survivors down keeps
+     them in input order too (heaps aside). */
+  size_t len = 0;
+  for (int t = 0; t < jobs; t++) {
+    memmove(recs + len, ch[t].recs, ch[t].kept * sizeof(sa_rec));
+    len += ch[t].kept;
+  }
+
+  if (ch != &one) {
+    free(ch);
+    free(tids);
+  }
+  return len;
+}
+
+/* Keeps the matches among recs[0..n) at its front, in input order, with
+   their scores set. Returns how many there are. */
+static inline size_t fr_filter(const sa_arena *a, sa_rec *recs, size_t n,
+                               const fr_scorer *sc, int jobs) {
+  return fr_score_chunks(a, recs, n, sc, 0, jobs);
+}
+
+/* Copies the best k of the scored recs[0..n) to out (room for k), sorted
+   best first. Returns how many were copied. */
+static inline size_t fr_select(const sa_rec *recs, size_t n, size_t k,
+                               sa_rec *out) {
+  size_t len = 0;
+  for (size_t i = 0; i < n; i++)
+    fr_keep(out, &len, k, recs[i]);
+  qsort(out, len, sizeof(sa_rec), fr_cmp);
+  return len;
+}
+
+/* Phase timings for --stats. */
+typedef struct {
+  size_t n, kept;
+  uint64_t ingest_ns, score_ns, select_ns;
+} fr_stats;
+
+static inline uint64_t fr_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* One line, "stats key=value ...", parsed by fuzzbench.c. */
+static inline void fr_print_stats(FILE *out, const fr_stats *st) {
+  fprintf(out,
+          "stats n=%zu kept=%zu ingest_ns=%llu score_ns=%llu select_ns=%llu\n",
+          st->n, st->kept, (unsigned long long)st->ingest_ns,
+          (unsigned long long)st->score_ns, (unsigned long long)st->select_ns);
+}
+
+/* Scores all of a->recs with up to jobs threads and leaves the best k
+   matches (every match if k == 0) sorted at the front of a->recs.
+   Returns how many there are. st (may be NULL) gets the phase times. */
+static inline size_t fr_rank_stats(sa_arena *a, const fr_scorer *sc, size_t k,
+                                   int jobs, fr_stats *st) {
+  uint64_t t0 = st ? fr_now_ns() : 0;
+  size_t len = fr_score_chunks(a, a->recs, a->n, sc, k, jobs);
+  uint64_t t1 = st ? fr_now_ns() : 0;
+  qsort(a->recs, len, sizeof(sa_rec), fr_cmp);
+  if (k && len > k)
+    len = k;
+  if (st) {
+    st->n = a->n;
+    st->kept = len;
+    st->score_ns = t1 - t0;
+    st->select_ns = fr_now_ns() - t1;
+  }
+  return len;
+}
+
+static inline size_t fr_rank(sa_arena *a, const fr_scorer *sc, size_t k,
+                             int jobs) {
+  return fr_rank_stats(a, sc, k, jobs, NULL);
+}
+
+/* pos[0..n) ascending byte offsets, written as "start+len,..." */
+static inline void fr_print_runs(FILE *out, const size_t *pos, size_t n) {
+  for (size_t i = 0; i < n;) {
+    size_t j = i + 1;
+    while (j < n && pos[j] == pos[j - 1] + 1)
+      j++;
+    fprintf(out, "%s%zu+%zu", i ? "," : "", pos[i], j - i);
+    i = j;
+  }
+}
+
+#endif // FUZZRANK_H
@@ -1,14 +1,37 @@
+// fuzzy_finder.c : rank stdin lines against a query
+// build: cc fuzzy_finder.c -O2 -march=native -pthread -o fuzzy_finder
+// usage: fuzzy_finder [--limit K] [-j N] [--stats] <query> < list
+//        fuzzy_finder --server LIST [--socket PATH] [--limit K] [-j N]
+//
+// Server mode loads LIST once ("-" = stdin, with --socket) and answers one
+// query per input line, from stdin or from each client connecting to the
+// Unix socket PATH, with a count line followed by that many results (the
+// best K, default 100). A query extending the previous one ("ab" -> "abc")
+// only rescores the previous matches: a line that does not contain "ab" as
+// a subsequence cannot contain "abc".
+
+#include "fuzzrank.h"
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define SERVER_LIMIT 100 // results per query when --limit is not given
 
 // --- Data Structures ---
 
+// Lines stay in the input arena; results are its {offset, len, score}
+// records, ranked by fuzzrank.h.
 typedef struct {
-  char *item;
-  int score;
-} ResultItem;
+  const char *text;
+  uint64_t mask; // sa_char_mask() of the query
+} Query;
 
 // --- Fuzzy Matching Core (Simplified) ---
 
@@ -39,63 +62,189 @@ int calculate_score(const char *text, const char *query) {
   return score;
 }
 
-// Comparison function for qsort (descending score)
-int compare_results(const void *a, const void *b) {
-  return ((ResultItem *)b)->score - ((ResultItem *)a)->score;
+// fr_scorer callback: < 0 = no match. Lines missing a query character
+// never get here: fuzzrank.h rejects them by their SA_MASKS mask with one
+// AND against fr_scorer.mask.
+static int score_line(void *arg, const char *line, size_t len) {
+  const Query *q = arg;
+  (void)len;
+  int score = calculate_score(line, q->text);
+  return score > 0 ? score : -1;
 }
 
-// --- Main Execution ---
+// --- Server Mode ---
 
-int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    fprintf(stderr, "Usage: %s <query>\n", argv[0]);
-    return 1;
+typedef struct {
+  sa_arena in;
+  sa_rec *set; // matches of the previous query, in input order
+  size_t nset;
+  char *last; // previous query; NULL = set is not valid
+  sa_rec *top; // room for limit results
+  size_t limit;
+  int jobs;
+} Server;
+
+static size_t server_query(Server *s, const char *text) {
+  Query query = {text, sa_char_mask(text, strlen(text))};
+  fr_scorer sc = {score_line, NULL, NULL, &query, query.mask};
+  if (!s->last || strncmp(text, s->last, strlen(s->last)) != 0) {
+    memcpy(s->set, s->in.recs, s->in.n * sizeof(sa_rec));
+    s->nset = s->in.n;
   }
-  const char *query = argv[1];
+  s->nset = fr_filter(&s->in, s->set, s->nset, &sc, s->jobs);
+  free(s->last);
+  s->last = strdup(text);
+  return fr_select(s->set, s->nset, s->limit, s->top);
+}
 
-  ResultItem *results = NULL;
-  size_t count = 0;
-  size_t capacity = 0;
+// Answers queries from in until EOF.
+static void serve(Server *s, FILE *in, FILE *out) {
   char *line = NULL;
-  size_t len = 0;
+  size_t cap = 0;
   ssize_t read;
-
-  // 1. Read input items from stdin (e.g., file list)
-  while ((read = getline(&line, &len, stdin)) != -1) {
-    // Remove trailing newline
-    if (read > 0 && line[read - 1] == '\n') {
+  while ((read = getline(&line, &cap, in)) != -1) {
+    if (read > 0 && line[read - 1] == '\n')
       line[read - 1] = '\0';
+    size_t count = server_query(s, line);
+    fprintf(out, "%zu\n", count);
+    for (size_t i = 0; i < count; i++) {
+      fwrite(sa_str(&s->in, &s->top[i]), 1, s->top[i].len, out);
+      putc('\n', out);
     }
+    if (fflush(out) != 0)
+      break; // client went away
+  }
+  free(line);
+  free(s->last); // the next client starts from scratch
+  s->last = NULL;
+}
 
-    int score = calculate_score(line, query);
-
-    if (score > 0) {
-      // Reallocate list if capacity is reached
-      if (count >= capacity) {
-        capacity = capacity == 0 ? 100 : capacity * 2;
-        results = realloc(results, capacity * sizeof(ResultItem));
-        if (!results) {
-          perror("realloc failed");
-          break;
-        }
-      }
-
-      results[count].item = strdup(line); // Copy the line
-      results[count].score = score;
-      count++;
+// One client at a time; runs until killed.
+static int serve_socket(Server *s, const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long\n", path);
+    return 1;
+  }
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path); // stale socket from an earlier run
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, 4) != 0) {
+    perror(path);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  for (;;) {
+    int c = accept(fd, NULL, NULL);
+    if (c < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("accept");
+      break;
     }
+    FILE *in = fdopen(c, "r");
+    int c2 = dup(c);
+    FILE *out = c2 >= 0 ? fdopen(c2, "w") : NULL;
+    if (in && out)
+      serve(s, in, out);
+    if (out)
+      fclose(out);
+    else if (c2 >= 0)
+      close(c2);
+    if (in)
+      fclose(in);
+    else
+      close(c);
   }
-  free(line);
+  close(fd);
+  unlink(path);
+  return 1;
+}
 
-  // 2. Sort the results
-  qsort(results, count, sizeof(ResultItem), compare_results);
+static int run_server(const char *list, const char *sock, size_t limit,
+                      int jobs) {
+  Server s = {.limit = limit ? limit : SERVER_LIMIT, .jobs = jobs};
+  int fd = strcmp(list, "-") == 0 ? STDIN_FILENO : open(list, O_RDONLY);
+  if (fd < 0 || (fd == STDIN_FILENO && !sock)) {
+    fprintf(stderr, "%s: %s\n", list,
+            fd < 0 ? strerror(errno) : "stdin carries the queries");
+    return 1;
+  }
+  if (sa_read_lines(&s.in, fd, SA_MASKS) != 0)
+    perror(list);
+  if (fd != STDIN_FILENO)
+    close(fd);
+  s.set = malloc((s.in.n ? s.in.n : 1) * sizeof(sa_rec));
+  s.top = malloc(s.limit * sizeof(sa_rec));
+  int rc = 1;
+  if (s.set && s.top) {
+    if (sock) {
+      rc = serve_socket(&s, sock);
+    } else {
+      serve(&s, stdin, stdout);
+      rc = 0;
+    }
+  }
+  free(s.set);
+  free(s.top);
+  sa_free(&s.in);
+  return rc;
+}
 
-  // 3. Print top results to stdout (Neovim reads this)
-  for (size_t i = 0; i < count; i++) {
-    printf("%s\n", results[i].item);
-    free(results[i].item);
+// --- Main Execution ---
+
+int main(int argc, char *argv[]) {
+  size_t limit = 0; // 0 = every match
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *server = NULL, *sock = NULL;
+  int stats = 0;
+  int argi = 1;
+  for (; argi < argc; argi++) {
+    if (strcmp(argv[argi], "--stats") == 0)
+      stats = 1;
+    else if (argi + 1 == argc)
+      break;
+    else if (strcmp(argv[argi], "--server") == 0)
+      server = argv[++argi];
+    else if (strcmp(argv[argi], "--socket") == 0)
+      sock = argv[++argi];
+    else if (strcmp(argv[argi], "--limit") == 0)
+      limit = strtoul(argv[++argi], NULL, 10);
+    else if (strcmp(argv[argi], "-j") == 0)
+      jobs = strtol(argv[++argi], NULL, 10);
+    else
+      break;
   }
-  free(results);
+  if (server && argi == argc)
+    return run_server(server, sock, limit, (int)jobs);
+  if (argi != argc - 1) {
+    fprintf(stderr,
+            "Usage: %s [--limit K] [-j N] [--stats] <query>\n"
+            "       %s --server LIST [--socket PATH] [--limit K] [-j N]\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+  Query query = {argv[argi], sa_char_mask(argv[argi], strlen(argv[argi]))};
+
+  // 1. Read input items from stdin (e.g., file list) in one go
+  fr_stats st;
+  uint64_t t0 = fr_now_ns();
+  sa_arena in;
+  if (sa_read_lines(&in, STDIN_FILENO, SA_MASKS) != 0)
+    perror("fuzzy_finder: stdin");
+  st.ingest_ns = fr_now_ns() - t0;
+
+  // 2. Score on all threads, keep the best (per thread, then merged)
+  fr_scorer sc = {score_line, NULL, NULL, &query, query.mask};
+  size_t count = fr_rank_stats(&in, &sc, limit, (int)jobs, &st);
+  if (stats)
+    fr_print_stats(stderr, &st);
+
+  // 3. Print top results to stdout (Neovim reads this)
+  for (size_t i = 0; i < count; i++)
+    printf("%s\n", sa_str(&in, &in.recs[i]));
+  sa_free(&in);
 
   return 0;
 }
@@ -52,5 +52,27 @@ function M.start_fuzzy_search(query, list_of_items)
   end))
 end
 
+-- Server mode: load the list once, then send one query per keystroke.
+-- Each answer is a count line followed by that many result lines.
+function M.start_server(list_file, on_results)
+  local pending, want = {}, nil
+  local job = vim.fn.jobstart({ "path/to/fuzzy_finder", "--server", list_file, "--limit", "50" }, {
+    on_stdout = function(_, data)
+      for i, line in ipairs(data) do
+        if i > 1 or #pending == 0 then table.insert(pending, line) else pending[#pending] = pending[#pending] .. line end
+      end
+      -- drain complete answers
+      while #pending > 1 do
+        want = want or tonumber(pending[1])
+        if #pending - 2 < want then break end
+        on_results(vim.list_slice(pending, 2, want + 1))
+        pending = vim.list_slice(pending, want + 2)
+        want = nil
+      end
+    end,
+  })
+  return function(query) vim.fn.chansend(job, query .. "\n") end
+end
+
 -- Example usage:
 -- M.start_fuzzy_search("main", { "main.c", "util.c", "documentation.md", "README.md" })
@@ -1,10 +1,20 @@
-
 // fzf-lite.c : simple fuzzy match CLI
-// build: cc fzf-lite.c -O2 -o fzf-lite
+// build: cc fzf-lite.c -O2 -pthread -o fzf-lite
+//
+// usage: fzf-lite [--limit K] [-j N] [--positions] [--stats] <query>
+// --limit K keeps only the K best matches in a min-heap while scoring, so
+// the final sort is over K items per thread. Input is read in bulk into a
+// str_arena.h buffer; nothing is copied. -j N scores on N threads
+// (default: online CPUs), see fuzzrank.h. --positions adds the matched
+// byte runs, "score<TAB>start+len,...<TAB>line", worked out again only for
+// the printed lines. --stats prints phase timings to stderr.
 
+#include "fuzzrank.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static int score(const char *q, const char *s) {
   int sc = 0, streak = 0;
@@ -20,45 +30,75 @@ static int score(const char *q, const char *s) {
   return *q ? -1 : sc; // -1 = not matched
 }
 
-typedef struct {
-  char *line;
-  int score;
-} Item;
+// The offsets score() matched, same greedy walk; returns how many.
+static size_t match_positions(const char *q, const char *s, size_t *pos) {
+  size_t n = 0;
+  for (const char *p = s; *p && *q; p++)
+    if (tolower(*q) == tolower(*p)) {
+      pos[n++] = (size_t)(p - s);
+      q++;
+    }
+  return n;
+}
 
-int cmp_item(const void *a, const void *b) {
-  const Item *x = a, *y = b;
-  return y->score - x->score;
+static int score_line(void *query, const char *s, size_t len) {
+  (void)len;
+  return score(query, s);
 }
 
 int main(int argc, char **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "usage: fzf-lite <query>\n");
+  size_t limit = 0; // 0 = keep every match
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int positions = 0, stats = 0;
+  int argi = 1;
+  for (; argi < argc; argi++) {
+    if (strcmp(argv[argi], "--positions") == 0)
+      positions = 1;
+    else if (strcmp(argv[argi], "--stats") == 0)
+      stats = 1;
+    else if (argi + 1 < argc && strcmp(argv[argi], "--limit") == 0)
+      limit = strtoul(argv[++argi], NULL, 10);
+    else if (argi + 1 < argc && strcmp(argv[argi], "-j") == 0)
+      jobs = strtol(argv[++argi], NULL, 10);
+    else
+      break;
+  }
+  if (argi >= argc) {
+    fprintf(stderr,
+            "usage: fzf-lite [--limit K] [-j N] [--positions] [--stats] <query>\n");
     return 1;
   }
 
-  char *query = argv[1];
-  Item *items = NULL;
-  size_t cap = 0, len = 0;
-  char buf[4096];
+  char *query = argv[argi];
+  fr_stats st;
+  uint64_t t0 = fr_now_ns();
+  sa_arena in;
+  if (sa_read_lines(&in, STDIN_FILENO, SA_MASKS) != 0)
+    perror("fzf-lite: stdin");
+  st.ingest_ns = fr_now_ns() - t0;
 
-  while (fgets(buf, sizeof(buf), stdin)) {
-    if (len == cap) {
-      cap = cap ? cap * 2 : 128;
-      items = realloc(items, cap * sizeof(Item));
-    }
-    items[len].line = strdup(buf);
-    items[len].score = score(query, buf);
-    len++;
-  }
-
-  qsort(items, len, sizeof(Item), cmp_item);
+  // score() matches a case-folded subsequence, so the masks apply
+  fr_scorer sc = {score_line, NULL, NULL, query,
+                  sa_char_mask(query, strlen(query))};
+  size_t len = fr_rank_stats(&in, &sc, limit, (int)jobs, &st);
+  if (stats)
+    fr_print_stats(stderr, &st);
 
+  size_t *pos = NULL;
+  if (positions)
+    pos = malloc((strlen(query) + 1) * sizeof(size_t));
   for (size_t i = 0; i < len; i++) {
-    if (items[i].score >= 0)
-      printf("%d\t%s", items[i].score, items[i].line);
-    free(items[i].line);
+    const char *line = sa_str(&in, &in.recs[i]);
+    printf("%d\t", in.recs[i].score);
+    if (positions) {
+      if (pos)
+        fr_print_runs(stdout, pos, match_positions(query, line, pos));
+      putchar('\t');
+    }
+    printf("%s\n", line);
   }
+  free(pos);
 
-  free(items);
+  sa_free(&in);
   return 0;
 }
@@ -1,8 +1,13 @@
 
 local M = {}
 
-function M.fzf(query, lines, cb)
-  local job = vim.fn.jobstart({"fzf-lite", query}, {
+-- limit (optional): only the best `limit` matches are returned
+function M.fzf(query, lines, cb, limit)
+  local cmd = {"fzf-lite", query}
+  if limit then
+    cmd = {"fzf-lite", "--limit", tostring(limit), query}
+  end
+  local job = vim.fn.jobstart(cmd, {
     stdin = "pipe",
     on_stdout = function(_, data)
       if data then cb(data) end
@@ -16,4 +21,15 @@ function M.fzf(query, lines, cb)
   vim.fn.chanclose(job, "stdin")
 end
 
+-- With --positions each result is "score<TAB>runs<TAB>line", where runs
+-- are 0-based "start+len" byte ranges ready for nvim_buf_add_highlight.
+function M.parse_positions(result)
+  local score, runs, line = result:match("^(%d+)\t([^\t]*)\t(.*)$")
+  local ranges = {}
+  for s, l in runs:gmatch("(%d+)%+(%d+)") do
+    table.insert(ranges, { tonumber(s), tonumber(s) + tonumber(l) })
+  end
+  return tonumber(score), line, ranges
+end
+
 return M
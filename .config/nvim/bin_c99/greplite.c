@@ -1,43 +1,399 @@
-
 // grep-lite.c : simple literal grep
-// build: cc grep-lite.c -O2 -o grep-lite
+// build: cc greplite.c -O2 -march=native -pthread -o grep-lite
+//
+// Each file is mapped (or slurped, for stdin/pipes) and searched as one
+// buffer; line numbers are only worked out for the hits.
+//
+// With several files, -j N workers (default: online CPUs) search in
+// parallel into per-file buffers, and the main thread prints them in
+// argument order, so output is identical to -j 1.
+//
+// With -f FILE, every line of FILE is a literal pattern; all of them are
+// compiled into one Aho-Corasick automaton and the data is scanned once.
+// Output is then file:line:pattern:text, once per pattern per line.
+//
+// Options end at the first non-option argument or at "--"; a pattern
+// that starts with '-' needs the "--" in front (grep-lite -- -x file).
 
+#define _POSIX_C_SOURCE 200809L
+#include "memscan.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-int main(int argc, char **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "usage: grep-lite <pattern> [files...]\n");
-    return 1;
+// --- Aho-Corasick (-f) ---
+
+// Dense DFA over byte classes: bytes that occur in no pattern share class 0,
+// so a row is only as wide as the pattern alphabet (+1) and the hot loop is
+// one table load per input byte.
+typedef struct {
+  uint8_t cls[256];
+  int ncls;
+  int nstates;
+  uint32_t *delta; // nstates * ncls
+  int32_t *out;    // pattern id ending in this state, or -1
+  uint32_t *emit;  // nearest state (self or via suffix links) with output
+  uint32_t *dlink; // next output state along the suffix chain, 0 = none
+  char **pats;
+  size_t npats;
+} AC;
+
+static void *xrealloc(void *p, size_t n) {
+  void *q = realloc(p, n);
+  if (!q) {
+    perror("grep-lite");
+    exit(1);
   }
+  return q;
+}
 
-  const char *pat = argv[1];
-  char buf[4096];
+static void ac_load_patterns(AC *ac, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) {
+    perror(path);
+    exit(1);
+  }
+  char *line = NULL;
+  size_t cap = 0, pcap = 0;
+  ssize_t n;
+  while ((n = getline(&line, &cap, fp)) != -1) {
+    while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r'))
+      line[--n] = '\0';
+    if (n == 0)
+      continue;
+    if (ac->npats == pcap) {
+      pcap = pcap ? pcap * 2 : 64;
+      ac->pats = xrealloc(ac->pats, pcap * sizeof(char *));
+    }
+    ac->pats[ac->npats++] = strdup(line);
+  }
+  free(line);
+  fclose(fp);
+}
 
-  if (argc == 2) {
-    int line = 1;
-    while (fgets(buf, sizeof buf, stdin)) {
-      if (strstr(buf, pat))
-        printf("stdin:%d:%s", line, buf);
-      line++;
+static void ac_build(AC *ac) {
+  memset(ac->cls, 0, sizeof ac->cls);
+  ac->ncls = 1;
+  for (size_t i = 0; i < ac->npats; i++)
+    for (const unsigned char *c = (const unsigned char *)ac->pats[i]; *c; c++)
+      if (!ac->cls[*c])
+        ac->cls[*c] = (uint8_t)ac->ncls++;
+
+  // Trie: delta row entries of 0 mean "no child" until the BFS fills them.
+  size_t maxstates = 1;
+  for (size_t i = 0; i < ac->npats; i++)
+    maxstates += strlen(ac->pats[i]);
+  size_t w = (size_t)ac->ncls;
+  ac->delta = calloc(maxstates * w, sizeof(uint32_t));
+  ac->out = malloc(maxstates * sizeof(int32_t));
+  if (!ac->delta || !ac->out) {
+    perror("grep-lite");
+    exit(1);
+  }
+  ac->out[0] = -1;
+  ac->nstates = 1;
+  for (size_t i = 0; i < ac->npats; i++) {
+    uint32_t s = 0;
+    for (const unsigned char *c = (const unsigned char *)ac->pats[i]; *c; c++) {
+      uint32_t *t = &ac->delta[s * w + ac->cls[*c]];
+      if (!*t) {
+        *t = (uint32_t)ac->nstates;
+        ac->out[ac->nstates++] = -1;
+      }
+      s = *t;
     }
-    return 0;
+    if (ac->out[s] < 0)
+      ac->out[s] = (int32_t)i;
   }
 
-  for (int i = 2; i < argc; i++) {
-    FILE *fp = fopen(argv[i], "r");
-    if (!fp)
-      continue;
+  // BFS: compute failure links and turn the trie into a full DFA.
+  size_t n = (size_t)ac->nstates;
+  uint32_t *fail = calloc(n, sizeof(uint32_t));
+  uint32_t *queue = malloc(n * sizeof(uint32_t));
+  ac->emit = calloc(n, sizeof(uint32_t));
+  ac->dlink = calloc(n, sizeof(uint32_t));
+  if (!fail || !queue || !ac->emit || !ac->dlink) {
+    perror("grep-lite");
+    exit(1);
+  }
+  size_t head = 0, tail = 0;
+  for (size_t c = 0; c < w; c++) {
+    uint32_t t = ac->delta[c];
+    if (t) {
+      ac->emit[t] = ac->out[t] >= 0 ? t : 0;
+      queue[tail++] = t;
+    }
+  }
+  while (head < tail) {
+    uint32_t s = queue[head++];
+    uint32_t *row = &ac->delta[s * w];
+    const uint32_t *frow = &ac->delta[fail[s] * w];
+    for (size_t c = 0; c < w; c++) {
+      uint32_t t = row[c];
+      if (!t) {
+        row[c] = frow[c];
+        continue;
+      }
+      fail[t] = frow[c];
+      ac->dlink[t] = ac->emit[fail[t]];
+      ac->emit[t] = ac->out[t] >= 0 ? t : ac->dlink[t];
+      queue[tail++] = t;
+    }
+  }
+  free(queue);
+  free(fail);
+}
 
-    int line = 1;
-    while (fgets(buf, sizeof buf, fp)) {
-      if (strstr(buf, pat))
-        printf("%s:%d:%s", argv[i], line, buf);
+static void grep_ac(const AC *ac, const char *name, const char *data,
+                    size_t len, FILE *out) {
+  // seen[id] == line suppresses repeats of one pattern on the same line.
+  size_t *seen = calloc(ac->npats, sizeof(size_t));
+  if (!seen) {
+    perror("grep-lite");
+    return;
+  }
+  const unsigned char *p = (const unsigned char *)data;
+  const unsigned char *end = p + len;
+  const unsigned char *bol = p;
+  const uint32_t *delta = ac->delta;
+  const size_t w = (size_t)ac->ncls;
+  size_t line = 1;
+  uint32_t s = 0;
+
+  for (; p < end; p++) {
+    s = delta[s * w + ac->cls[*p]];
+    if (*p == '\n') {
       line++;
+      bol = p + 1;
+    }
+    for (uint32_t e = ac->emit[s]; e; e = ac->dlink[e]) {
+      int32_t id = ac->out[e];
+      if (seen[id] == line)
+        continue;
+      seen[id] = line;
+      const char *eol = ms_line_end((const char *)p, (const char *)end);
+      fprintf(out, "%s:%zu:%s:", name, line, ac->pats[id]);
+      fwrite(bol, 1, (size_t)(eol - (const char *)bol), out);
+      fputc('\n', out);
     }
+  }
+  free(seen);
+}
+
+// --- Search ---
+
+typedef struct {
+  const char *pat; // single literal
+  size_t plen;
+  const AC *ac; // -f patterns, NULL otherwise
+} Search;
 
-    fclose(fp);
+static void grep_literal(const char *name, const char *data, size_t len,
+                         const char *pat, size_t plen, FILE *out) {
+  const char *end = data + len;
+  const char *cur = data;  // search resumes here
+  const char *mark = data; // newlines before mark are already counted
+  size_t line = 1;
+
+  while (cur < end) {
+    const char *hit = ms_find(cur, (size_t)(end - cur), pat, plen);
+    if (!hit)
+      break;
+    const char *bol = ms_line_start(cur, hit);
+    const char *eol = ms_line_end(hit, end);
+
+    line += ms_count_lines(mark, (size_t)(bol - mark));
+    fprintf(out, "%s:%zu:", name, line);
+    fwrite(bol, 1, (size_t)(eol - bol), out);
+    fputc('\n', out);
+
+    if (eol == end)
+      break;
+    cur = mark = eol + 1;
+    line++;
+  }
+}
+
+static void grep_buf(const char *name, const char *data, size_t len,
+                     const Search *s, FILE *out) {
+  if (s->ac)
+    grep_ac(s->ac, name, data, len, out);
+  else
+    grep_literal(name, data, len, s->pat, s->plen, out);
+}
+
+static void grep_fd(const char *name, int fd, const Search *s, FILE *out) {
+  ms_buf b;
+  if (ms_map_fd(fd, &b) != 0) {
+    perror(name);
+    return;
+  }
+  grep_buf(name, b.data, b.len, s, out);
+  ms_release(&b);
+}
+
+static void grep_path(const char *path, const Search *s, FILE *out) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+  grep_fd(path, fd, s, out);
+  close(fd);
+}
+
+// --- Parallel mode ---
+
+typedef struct {
+  const char *path;
+  char *out; // buffered matches, owned until printed
+  size_t outlen;
+  int done;
+} Job;
+
+typedef struct {
+  Job *jobs;
+  int njobs;
+  int next;    // next job to hand out
+  int emitted; // jobs already printed
+  int window;  // max jobs in flight ahead of the printer
+  const Search *search;
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+} Pool;
+
+static void *worker(void *arg) {
+  Pool *p = arg;
+  for (;;) {
+    pthread_mutex_lock(&p->mu);
+    while (p->next < p->njobs && p->next >= p->emitted + p->window)
+      pthread_cond_wait(&p->cv, &p->mu);
+    if (p->next >= p->njobs) {
+      pthread_mutex_unlock(&p->mu);
+      return NULL;
+    }
+    Job *j = &p->jobs[p->next++];
+    pthread_mutex_unlock(&p->mu);
+
+    FILE *m = open_memstream(&j->out, &j->outlen);
+    if (m) {
+      grep_path(j->path, p->search, m);
+      fclose(m);
+    }
+
+    pthread_mutex_lock(&p->mu);
+    j->done = 1;
+    pthread_cond_broadcast(&p->cv);
+    pthread_mutex_unlock(&p->mu);
+  }
+}
+
+static void grep_parallel(char **paths, int n, int nthreads,
+                          const Search *s) {
+  Pool p = {.njobs = n, .window = nthreads * 4, .search = s};
+  p.jobs = calloc((size_t)n, sizeof(Job));
+  pthread_t *tids = malloc((size_t)nthreads * sizeof(pthread_t));
+  if (!p.jobs || !tids) {
+    perror("grep-lite");
+    exit(1);
+  }
+  for (int i = 0; i < n; i++)
+    p.jobs[i].path = paths[i];
+  pthread_mutex_init(&p.mu, NULL);
+  pthread_cond_init(&p.cv, NULL);
+
+  int started = 0;
+  for (; started < nthreads; started++)
+    if (pthread_create(&tids[started], NULL, worker, &p) != 0)
+      break;
+  if (started == 0) {
+    for (int i = 0; i < n; i++)
+      grep_path(paths[i], s, stdout);
+    p.next = n;
+  }
+
+  // Merger: print finished jobs strictly in argument order.
+  for (int i = 0; i < n && started; i++) {
+    Job *j = &p.jobs[i];
+    pthread_mutex_lock(&p.mu);
+    while (!j->done)
+      pthread_cond_wait(&p.cv, &p.mu);
+    pthread_mutex_unlock(&p.mu);
+
+    if (j->outlen)
+      fwrite(j->out, 1, j->outlen, stdout);
+    free(j->out);
+
+    pthread_mutex_lock(&p.mu);
+    p.emitted++;
+    pthread_cond_broadcast(&p.cv);
+    pthread_mutex_unlock(&p.mu);
+  }
+
+  for (int t = 0; t < started; t++)
+    pthread_join(tids[t], NULL);
+  pthread_cond_destroy(&p.cv);
+  pthread_mutex_destroy(&p.mu);
+  free(tids);
+  free(p.jobs);
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: grep-lite [-j N] ([--] <pattern> | -f FILE) [files...]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *patfile = NULL;
+  int opt;
+  // '+': no argument reordering, the pattern and files are never options
+  while ((opt = getopt(argc, argv, "+j:f:")) != -1) {
+    switch (opt) {
+    case 'j':
+      nthreads = strtol(optarg, NULL, 10);
+      break;
+    case 'f':
+      patfile = optarg;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (!patfile && optind >= argc)
+    usage();
+  if (nthreads < 1)
+    nthreads = 1;
+
+  Search s = {0};
+  AC ac = {0};
+  if (patfile) {
+    ac_load_patterns(&ac, patfile);
+    if (ac.npats == 0)
+      return 0;
+    ac_build(&ac);
+    s.ac = &ac;
+  } else {
+    s.pat = argv[optind++];
+    s.plen = strlen(s.pat);
+  }
+  char **paths = argv + optind;
+  int npaths = argc - optind;
+
+  if (npaths == 0) {
+    grep_fd("stdin", STDIN_FILENO, &s, stdout);
+    return 0;
+  }
+
+  if (nthreads > npaths)
+    nthreads = npaths;
+  if (nthreads == 1) {
+    for (int i = 0; i < npaths; i++)
+      grep_path(paths[i], &s, stdout);
+    return 0;
   }
 
+  grep_parallel(paths, npaths, (int)nthreads, &s);
   return 0;
 }
@@ -1,6 +1,6 @@
 
 local function grep(pattern, file, cb)
-  vim.fn.jobstart({"grep-lite", pattern, file}, {
+  vim.fn.jobstart({"grep-lite", "--", pattern, file}, {
     stdout_buffered = true,
     on_stdout = function(_, data)
       cb(data)
@@ -0,0 +1,275 @@
+#ifndef MEMSCAN_H
+#define MEMSCAN_H
+
+/*
+    memscan.h — whole-file scanning helpers (single-header)
+
+    Features:
+      - ms_map_file / ms_map_fd: map a file read-only, or slurp it with a
+        read loop when mmap is not possible (pipes, ttys, stdin)
+      - ms_find: literal substring search, SSE2/AVX2 first/last-byte filter
+        with a scalar fallback
+      - ms_count_lines: count '\n' bytes in a range (SIMD compare+popcount)
+      - ms_line_start / ms_line_end: line boundaries around a hit
+      - ms_line_index: offsets of every line start, in one SIMD pass
+
+    All functions are static inline; just include the header.
+*/
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+typedef struct {
+  const char *data;
+  size_t len;
+  int mapped; /* 1 = munmap on release, 0 = free */
+} ms_buf;
+
+/* ============================
+      FILE LOADING
+   ============================ */
+
+static inline int ms_slurp_fd(int fd, ms_buf *b) {
+  size_t cap = 1 << 16, len = 0;
+  char *p = malloc(cap);
+  if (!p)
+    return -1;
+  for (;;) {
+    if (len == cap) {
+      char *np = realloc(p, cap * 2);
+      if (!np) {
+        free(p);
+        return -1;
+      }
+      p = np;
+      cap *= 2;
+    }
+    ssize_t n = read(fd, p + len, cap - len);
+    if (n < 0) {
+      free(p);
+      return -1;
+    }
+    if (n == 0)
+      break;
+    len += (size_t)n;
+  }
+  b->data = p;
+  b->len = len;
+  b->mapped = 0;
+  return 0;
+}
+
+/* Returns 0 on success, -1 on error (errno set). An empty file yields
+   data == NULL, len == 0. */
+static inline int ms_map_fd(int fd, ms_buf *b) {
+  struct stat st;
+  *b = (ms_buf){0};
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    if (st.st_size == 0)
+      return 0;
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+      madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+      b->data = p;
+      b->len = (size_t)st.st_size;
+      b->mapped = 1;
+      return 0;
+    }
+  }
+  return ms_slurp_fd(fd, b);
+}
+
+static inline int ms_map_file(const char *path, ms_buf *b) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  int rc = ms_map_fd(fd, b);
+  close(fd);
+  return rc;
+}
+
+static inline void ms_release(ms_buf *b) {
+  if (b->mapped)
+    munmap((void *)b->data, b->len);
+  else
+    free((void *)b->data);
+  *b = (ms_buf){0};
+}
+
+/* ============================
+      LITERAL SEARCH
+   ============================ */
+
+static inline const char *ms_find_scalar(const char *hay, size_t n,
+                                         const char *needle, size_t m) {
+  if (m == 0)
+    return hay;
+  const char *end = hay + n;
+  while ((size_t)(end - hay) >= m) {
+    const char *p = memchr(hay, needle[0], (size_t)(end - hay) - m + 1);
+    if (!p)
+      return NULL;
+    if (p[m - 1] == needle[m - 1] && memcmp(p, needle, m) == 0)
+      return p;
+    hay = p + 1;
+  }
+  return NULL;
+}
+
+/* First occurrence of needle[0..m) in hay[0..n), or NULL.
+   Blocks are filtered by comparing the first and the last needle byte at
+   once; only surviving candidates pay for a memcmp. */
+static inline const char *ms_find(const char *hay, size_t n,
+                                  const char *needle, size_t m) {
+  if (m == 0)
+    return hay;
+  if (m > n)
+    return NULL;
+  if (m == 1)
+    return memchr(hay, needle[0], n);
+
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i f32 = _mm256_set1_epi8(needle[0]);
+  const __m256i l32 = _mm256_set1_epi8(needle[m - 1]);
+  for (; i + m - 1 + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(hay + i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(hay + i + m - 1));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(a, f32), _mm256_cmpeq_epi8(b, l32)));
+    while (mask) {
+      unsigned bit = (unsigned)__builtin_ctz(mask);
+      if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0)
+        return hay + i + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i f16 = _mm_set1_epi8(needle[0]);
+  const __m128i l16 = _mm_set1_epi8(needle[m - 1]);
+  for (; i + m - 1 + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+    unsigned mask = (unsigned)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(a, f16), _mm_cmpeq_epi8(b, l16)));
+    while (mask) {
+      unsigned bit = (unsigned)__builtin_ctz(mask);
+      if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0)
+        return hay + i + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif
+  return ms_find_scalar(hay + i, n - i, needle, m);
+}
+
+/* ============================
+      LINE HELPERS
+   ============================ */
+
+/* Number of '\n' bytes in p[0..n). */
+static inline size_t ms_count_lines(const char *p, size_t n) {
+  size_t count = 0, i = 0;
+#if defined(__AVX2__)
+  const __m256i nl32 = _mm256_set1_epi8('\n');
+  for (; i + 32 <= n; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    count += (size_t)__builtin_popcount(
+        (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32)));
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i nl16 = _mm_set1_epi8('\n');
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    count += (size_t)__builtin_popcount(
+        (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16)));
+  }
+#endif
+  for (; i < n; i++)
+    count += p[i] == '\n';
+  return count;
+}
+
+/* Start of the line containing p, never before lo. */
+static inline const char *ms_line_start(const char *lo, const char *p) {
+  while (p > lo && p[-1] != '\n')
+    p--;
+  return p;
+}
+
+/* The '\n' ending the line containing p, or hi if the line is unterminated. */
+static inline const char *ms_line_end(const char *p, const char *hi) {
+  const char *nl = memchr(p, '\n', (size_t)(hi - p));
+  return nl ? nl : hi;
+}
+
+static inline int ms_push_off(size_t **v, size_t *n, size_t *cap, size_t off) {
+  if (*n == *cap) {
+    size_t nc = *cap ? *cap * 2 : 1024;
+    size_t *nv = realloc(*v, nc * sizeof(size_t));
+    if (!nv)
+      return -1;
+    *v = nv;
+    *cap = nc;
+  }
+  (*v)[(*n)++] = off;
+  return 0;
+}
+
+/* Start offset of every line in p[0..n) into a malloc'd *out (free it);
+   line i spans [off[i], off[i+1]) including its '\n'. A trailing newline
+   does not start an extra line. Returns the line count, 0 for an empty
+   buffer, or (size_t)-1 if out of memory. */
+static inline size_t ms_line_index(const char *p, size_t n, size_t **out) {
+  size_t *v = NULL, cnt = 0, cap = 0, i = 0;
+  *out = NULL;
+  if (n == 0)
+    return 0;
+  if (ms_push_off(&v, &cnt, &cap, 0) != 0)
+    return (size_t)-1;
+#if defined(__AVX2__)
+  const __m256i nl32 = _mm256_set1_epi8('\n');
+  for (; i + 32 <= n; i += 32) {
+    __m256i b = _mm256_loadu_si256((const __m256i *)(p + i));
+    unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, nl32));
+    for (; mask; mask &= mask - 1)
+      if (ms_push_off(&v, &cnt, &cap, i + (size_t)__builtin_ctz(mask) + 1))
+        goto oom;
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i nl16 = _mm_set1_epi8('\n');
+  for (; i + 16 <= n; i += 16) {
+    __m128i b = _mm_loadu_si128((const __m128i *)(p + i));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(b, nl16));
+    for (; mask; mask &= mask - 1)
+      if (ms_push_off(&v, &cnt, &cap, i + (size_t)__builtin_ctz(mask) + 1))
+        goto oom;
+  }
+#endif
+  for (; i < n; i++)
+    if (p[i] == '\n' && ms_push_off(&v, &cnt, &cap, i + 1))
+      goto oom;
+  if (v[cnt - 1] == n)
+    cnt--;
+  *out = v;
+  return cnt;
+oom:
+  free(v);
+  return (size_t)-1;
+}
+
+#endif // MEMSCAN_H
@@ -1,130 +1,660 @@
+// nvim_regexbatch.c : regex search & replace over a directory tree
+// build: cc nvim_regexbatch.c -O2 -march=native -lpcre2-8 -o nvim-regexbatch
+//
+// Each file is mapped and matched as one buffer (^/$ match at line
+// boundaries). Replacement runs pcre2_substitute over the whole buffer and
+// writes the result to a temp file in the same directory, which is then
+// renamed over the original; files without matches are never written.
+//
+// Walker threads list directories (d_type, fstatat only for DT_UNKNOWN)
+// into a bounded queue drained by matcher threads, each with its own
+// pcre2 match data and JIT stack. --jobs N caps the total thread count
+// (default: online CPUs); --jobs 1 walks and matches on the main thread.
+//
+// --json prints one JSON object per match instead of the per-file counts:
+//   {"file":..,"line":..,"col":..,"start":..,"end":..,"text":..,"replace":..}
+// line/col are 1-based (col in bytes), start/end are byte offsets into the
+// file and "replace" is what the match would become. Records are built in a
+// per-thread buffer and written out in whole-record chunks under one lock.
+
+#define _GNU_SOURCE // d_type
+#define PCRE2_CODE_UNIT_WIDTH 8
+#include "memscan.h"
 #include <dirent.h>
+#include <errno.h>
 #include <getopt.h>
+#include <fcntl.h>
 #include <pcre2.h> // Need libpcre2-dev
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
-#define MAX_PATH 1024
-#define BUFFER_SIZE 4096
+#define BINARY_PROBE 8000 // like git: a NUL in the first 8000 bytes
+#define QUEUE_CAP 4096    // paths buffered between walkers and matchers
+#define OUT_BUF (256 * 1024) // per-thread --json output buffer
+
+// Buffered stdout shared by all threads. Only complete records (everything
+// before rec) are ever written, so output from different threads never
+// interleaves mid-line.
+typedef struct {
+  char *buf;
+  size_t len, cap;
+  size_t rec; // end of the last complete record
+} Writer;
+
+static pthread_mutex_t out_mu = PTHREAD_MUTEX_INITIALIZER;
+
+static void write_all(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    p += w;
+    n -= (size_t)w;
+  }
+}
 
-void process_file(const char *path, pcre2_code *re, const char *replace,
-                  int dry_run) {
-  FILE *f = fopen(path, dry_run ? "r" : "r+");
-  if (!f) {
-    perror("fopen");
+static void w_flush(Writer *w) {
+  if (w->rec == 0)
     return;
+  pthread_mutex_lock(&out_mu);
+  write_all(STDOUT_FILENO, w->buf, w->rec);
+  pthread_mutex_unlock(&out_mu);
+  memmove(w->buf, w->buf + w->rec, w->len - w->rec);
+  w->len -= w->rec;
+  w->rec = 0;
+}
+
+static int w_reserve(Writer *w, size_t n) {
+  if (w->len + n <= w->cap)
+    return 0;
+  w_flush(w);
+  if (w->len + n <= w->cap)
+    return 0;
+  // a single record larger than the buffer
+  size_t nc = w->cap ? w->cap : OUT_BUF;
+  while (nc < w->len + n)
+    nc *= 2;
+  char *nb = realloc(w->buf, nc);
+  if (!nb)
+    return -1;
+  w->buf = nb;
+  w->cap = nc;
+  return 0;
+}
+
+static void w_put(Writer *w, const char *s, size_t n) {
+  if (w_reserve(w, n) == 0) {
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+  }
+}
+
+static void w_fmt_size(Writer *w, const char *key, size_t v) {
+  char tmp[48];
+  int n = snprintf(tmp, sizeof(tmp), ",\"%s\":%zu", key, v);
+  w_put(w, tmp, (size_t)n);
+}
+
+static void w_json_str(Writer *w, const char *s, size_t n) {
+  static const char hex[] = "0123456789abcdef";
+  if (w_reserve(w, n * 6 + 2) != 0) // worst case: every byte as \u00XX
+    return;
+  char *o = w->buf + w->len;
+  *o++ = '"';
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\') {
+      *o++ = '\\';
+      *o++ = (char)c;
+    } else if (c == '\n') {
+      *o++ = '\\';
+      *o++ = 'n';
+    } else if (c == '\t') {
+      *o++ = '\\';
+      *o++ = 't';
+    } else if (c < 0x20) {
+      memcpy(o, "\\u00", 4);
+      o[4] = hex[c >> 4];
+      o[5] = hex[c & 15];
+      o += 6;
+    } else {
+      *o++ = (char)c;
+    }
+  }
+  *o++ = '"';
+  w->len = (size_t)(o - w->buf);
+}
+
+static void w_end_record(Writer *w) {
+  w_put(w, "}\n", 2);
+  w->rec = w->len;
+}
+
+// Per-thread matching state: the compiled pattern is shared (read-only
+// after JIT compilation), everything pcre2 writes to is not.
+typedef struct {
+  const pcre2_code *re;
+  pcre2_match_data *md;
+  pcre2_match_context *mctx;
+  pcre2_jit_stack *jit;
+  Writer out;  // --json records
+  char *rbuf;  // replacement text of one match
+  size_t rcap;
+} Matcher;
+
+typedef struct {
+  const char *replace;
+  int recursive;
+  int dry_run;
+  int json;
+} Options;
+
+static int matcher_init(Matcher *m, const pcre2_code *re) {
+  *m = (Matcher){.re = re};
+  m->md = pcre2_match_data_create_from_pattern(re, NULL);
+  m->mctx = pcre2_match_context_create(NULL);
+  m->jit = pcre2_jit_stack_create(32 * 1024, 512 * 1024, NULL);
+  if (!m->md || !m->mctx)
+    return -1;
+  if (m->jit)
+    pcre2_jit_stack_assign(m->mctx, NULL, m->jit);
+  return 0;
+}
+
+static void matcher_free(Matcher *m) {
+  w_flush(&m->out);
+  free(m->out.buf);
+  free(m->rbuf);
+  pcre2_jit_stack_free(m->jit);
+  pcre2_match_context_free(m->mctx);
+  pcre2_match_data_free(m->md);
+}
+
+static int match(Matcher *m, const char *data, size_t len, PCRE2_SIZE off) {
+  return pcre2_match(m->re, (PCRE2_SPTR)data, len, off, 0, m->md, m->mctx);
+}
+
+// Count matches without building any output.
+static int count_matches(Matcher *m, const char *data, size_t len) {
+  int n = 0;
+  PCRE2_SIZE off = 0;
+  while (off <= len && match(m, data, len, off) > 0) {
+    PCRE2_SIZE *ov = pcre2_get_ovector_pointer(m->md);
+    n++;
+    off = ov[1] > ov[0] ? ov[1] : ov[1] + 1;
   }
+  return n;
+}
 
-  char buf[BUFFER_SIZE];
-  size_t len;
-  int changes = 0;
-  while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
-    // Simple replace (expand for full PCRE2 matching)
-    pcre2_match_data *match_data =
-        pcre2_match_data_create_from_pattern(re, NULL);
-    int rc = pcre2_match(re, (PCRE2_SPTR)buf, len, 0, 0, match_data, NULL);
-    if (rc > 0) {
-      changes++;
-      // For demo, just print; in real, rewrite file
-      if (!dry_run) {
-        // Implement replace logic here (use pcre2_substitute)
-        printf("Would replace in %s\n", path);
-      } else {
-        printf("Match in %s\n", path);
+// One --json record per match. Line numbers are counted incrementally from
+// the previous match; the replacement comes from pcre2_substitute reusing
+// the match data (SUBSTITUTE_MATCHED) and returning only the replacement.
+static void report_matches(Matcher *m, const Options *o, const char *path,
+                           const char *data, size_t len) {
+  const char *mark = data, *bol = data;
+  size_t line = 1;
+  PCRE2_SIZE off = 0;
+  while (off <= len && match(m, data, len, off) > 0) {
+    PCRE2_SIZE *ov = pcre2_get_ovector_pointer(m->md);
+    size_t so = ov[0], eo = ov[1] > so ? ov[1] : so; // \K can invert them
+    const char *hit = data + so;
+    // Only the gap since the previous hit is scanned: without a newline in
+    // it, hit is still on bol's line (many hits on one long line stay
+    // linear in its length)
+    size_t nl = ms_count_lines(mark, (size_t)(hit - mark));
+    if (nl) {
+      line += nl;
+      bol = ms_line_start(mark, hit);
+    }
+    mark = hit;
+
+    PCRE2_SIZE rlen = m->rcap;
+    int rc = PCRE2_ERROR_NOMEMORY;
+    for (;;) {
+      if (m->rcap) {
+        rlen = m->rcap;
+        rc = pcre2_substitute(
+            m->re, (PCRE2_SPTR)data, len, 0,
+            PCRE2_SUBSTITUTE_MATCHED | PCRE2_SUBSTITUTE_REPLACEMENT_ONLY |
+                PCRE2_SUBSTITUTE_OVERFLOW_LENGTH,
+            m->md, m->mctx, (PCRE2_SPTR)o->replace, PCRE2_ZERO_TERMINATED,
+            (PCRE2_UCHAR *)m->rbuf, &rlen);
+        if (rc != PCRE2_ERROR_NOMEMORY || rlen <= m->rcap)
+          break;
       }
+      size_t nc = rlen > 256 ? rlen : 256;
+      char *nb = realloc(m->rbuf, nc);
+      if (!nb)
+        break;
+      m->rbuf = nb;
+      m->rcap = nc;
+    }
+
+    Writer *w = &m->out;
+    w_put(w, "{\"file\":", 8);
+    w_json_str(w, path, strlen(path));
+    w_fmt_size(w, "line", line);
+    w_fmt_size(w, "col", (size_t)(hit - bol) + 1);
+    w_fmt_size(w, "start", so);
+    w_fmt_size(w, "end", eo);
+    w_put(w, ",\"text\":", 8);
+    w_json_str(w, hit, eo - so);
+    w_put(w, ",\"replace\":", 11);
+    if (rc >= 0)
+      w_json_str(w, m->rbuf, rlen);
+    else
+      w_put(w, "null", 4);
+    w_end_record(w);
+
+    off = ov[1] > ov[0] ? ov[1] : ov[1] + 1;
+  }
+}
+
+// Write buf to a temp file next to path, sync it, then rename it over path.
+static int replace_file(const char *path, mode_t mode, const char *buf,
+                        size_t len) {
+  size_t plen = strlen(path);
+  char *tmp = malloc(plen + 16);
+  if (!tmp)
+    return -1;
+  const char *slash = strrchr(path, '/');
+  int dlen = slash ? (int)(slash - path + 1) : 0;
+  snprintf(tmp, plen + 16, "%.*s.%s.XXXXXX", dlen, path,
+           slash ? slash + 1 : path);
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    free(tmp);
+    return -1;
+  }
+  fchmod(fd, mode & 07777);
+  size_t off = 0;
+  while (off < len) {
+    ssize_t w = write(fd, buf + off, len - off);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    off += (size_t)w;
+  }
+  // Data on disk before the rename, or a crash could leave an empty file
+  int ok = off == len && fsync(fd) == 0;
+  int rc = 0;
+  if (close(fd) != 0 || !ok || rename(tmp, path) != 0) {
+    unlink(tmp);
+    rc = -1;
+  }
+  free(tmp);
+  return rc;
+}
+
+void process_file(const char *path, Matcher *m, const Options *o) {
+  // O_NOFOLLOW: symlinks are left alone, rename would replace the link
+  int fd = open(path, O_RDONLY | O_NOFOLLOW);
+  if (fd < 0)
+    return;
+  ms_buf b;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || ms_map_fd(fd, &b) != 0) {
+    close(fd);
+    return;
+  }
+  close(fd);
+
+  size_t probe = b.len < BINARY_PROBE ? b.len : BINARY_PROBE;
+  if (b.len == 0 || memchr(b.data, '\0', probe) ||
+      match(m, b.data, b.len, 0) <= 0) {
+    ms_release(&b);
+    return;
+  }
+
+  if (o->json) {
+    report_matches(m, o, path, b.data, b.len);
+  } else if (o->dry_run) {
+    // one printf per file so lines from different threads never interleave
+    printf("Match in %s\n%d changes in %s\n", path,
+           count_matches(m, b.data, b.len), path);
+  }
+  if (o->dry_run) {
+    ms_release(&b);
+    return;
+  }
+
+  // Output usually stays close to the input size; on overflow
+  // PCRE2_SUBSTITUTE_OVERFLOW_LENGTH reports the exact size needed.
+  PCRE2_SIZE cap = b.len + b.len / 8 + 256, outlen;
+  char *out = NULL;
+  int rc;
+  for (;;) {
+    char *grown = realloc(out, cap);
+    if (!grown) {
+      rc = PCRE2_ERROR_NOMEMORY;
+      break;
     }
-    pcre2_match_data_free(match_data);
+    out = grown;
+    outlen = cap;
+    rc = pcre2_substitute(
+        m->re, (PCRE2_SPTR)b.data, b.len, 0,
+        PCRE2_SUBSTITUTE_GLOBAL | PCRE2_SUBSTITUTE_OVERFLOW_LENGTH, m->md,
+        m->mctx, (PCRE2_SPTR)o->replace, PCRE2_ZERO_TERMINATED,
+        (PCRE2_UCHAR *)out, &outlen);
+    if (rc != PCRE2_ERROR_NOMEMORY || outlen <= cap)
+      break;
+    cap = outlen;
+  }
+
+  if (rc < 0) {
+    PCRE2_UCHAR msg[256];
+    pcre2_get_error_message(rc, msg, sizeof(msg));
+    fprintf(stderr, "%s: %s\n", path, (char *)msg);
+  } else if (rc > 0) {
+    if (replace_file(path, st.st_mode, out, outlen) != 0)
+      perror(path);
+    else if (!o->json)
+      printf("%d changes in %s\n", rc, path);
   }
-  fclose(f);
-  if (changes)
-    printf("%d changes in %s\n", changes, path);
+  free(out);
+  ms_release(&b);
 }
 
-void walk_and_process(const char *dir, pcre2_code *re, const char *replace,
-                      int recursive, int dry_run) {
+// --- Pipeline: walkers -> bounded path queue -> matchers ---
+
+typedef struct {
+  const Options *opt;
+  const pcre2_code *re;
+
+  // directories still to list (LIFO keeps the working set small)
+  char **dirs;
+  size_t ndirs, dircap;
+  int busy_walkers; // walkers currently listing a directory
+  int live_walkers; // walkers not yet exited
+  pthread_cond_t dir_cv;
+
+  // files for the matchers; NULL queue = match inline (--jobs 1)
+  char **files;
+  size_t head, count;
+  int closed;
+  pthread_cond_t not_empty, not_full;
+
+  pthread_mutex_t mu;
+} Pipeline;
+
+static char *join_path(const char *dir, const char *name) {
+  size_t dl = strlen(dir), nl = strlen(name);
+  char *p = malloc(dl + nl + 2);
+  if (!p)
+    return NULL;
+  memcpy(p, dir, dl);
+  p[dl] = '/';
+  memcpy(p + dl + 1, name, nl + 1);
+  return p;
+}
+
+static void push_dir(Pipeline *pl, char *dir) {
+  pthread_mutex_lock(&pl->mu);
+  if (pl->ndirs == pl->dircap) {
+    size_t nc = pl->dircap ? pl->dircap * 2 : 256;
+    char **nd = realloc(pl->dirs, nc * sizeof(char *));
+    if (!nd) {
+      pthread_mutex_unlock(&pl->mu);
+      free(dir);
+      return;
+    }
+    pl->dirs = nd;
+    pl->dircap = nc;
+  }
+  pl->dirs[pl->ndirs++] = dir;
+  pthread_cond_signal(&pl->dir_cv);
+  pthread_mutex_unlock(&pl->mu);
+}
+
+static void push_file(Pipeline *pl, char *path) {
+  pthread_mutex_lock(&pl->mu);
+  while (pl->count == QUEUE_CAP)
+    pthread_cond_wait(&pl->not_full, &pl->mu);
+  pl->files[(pl->head + pl->count++) % QUEUE_CAP] = path;
+  pthread_cond_signal(&pl->not_empty);
+  pthread_mutex_unlock(&pl->mu);
+}
+
+// List one directory: subdirectories go back on the dir stack, regular
+// files to the matchers (or straight to m when running inline).
+static void list_dir(Pipeline *pl, const char *dir, Matcher *m) {
   DIR *d = opendir(dir);
   if (!d) {
-    perror("opendir");
+    perror(dir);
     return;
   }
-
   struct dirent *entry;
   while ((entry = readdir(d))) {
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+    const char *name = entry->d_name;
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
       continue;
 
-    char path[MAX_PATH];
-    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
-
-    struct stat st;
-    if (stat(path, &st) == -1)
+    unsigned char type = entry->d_type;
+    if (type == DT_UNKNOWN) {
+      struct stat st;
+      if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        continue;
+      type = S_ISREG(st.st_mode)   ? DT_REG
+             : S_ISDIR(st.st_mode) ? DT_DIR
+                                   : DT_UNKNOWN;
+    }
+    if (type != DT_REG && !(type == DT_DIR && pl->opt->recursive))
       continue;
 
-    if (S_ISREG(st.st_mode)) {
-      process_file(path, re, replace, dry_run);
-    } else if (recursive && S_ISDIR(st.st_mode)) {
-      walk_and_process(path, re, replace, recursive, dry_run);
+    char *path = join_path(dir, name);
+    if (!path)
+      continue;
+    if (type == DT_DIR) {
+      push_dir(pl, path);
+    } else if (m) {
+      process_file(path, m, pl->opt);
+      free(path);
+    } else {
+      push_file(pl, path);
     }
   }
   closedir(d);
 }
 
+static void walk(Pipeline *pl, Matcher *inline_matcher) {
+  for (;;) {
+    pthread_mutex_lock(&pl->mu);
+    while (pl->ndirs == 0 && pl->busy_walkers > 0)
+      pthread_cond_wait(&pl->dir_cv, &pl->mu);
+    if (pl->ndirs == 0) { // nothing queued and nobody can add more
+      pthread_cond_broadcast(&pl->dir_cv);
+      pthread_mutex_unlock(&pl->mu);
+      return;
+    }
+    char *dir = pl->dirs[--pl->ndirs];
+    pl->busy_walkers++;
+    pthread_mutex_unlock(&pl->mu);
+
+    list_dir(pl, dir, inline_matcher);
+    free(dir);
+
+    pthread_mutex_lock(&pl->mu);
+    if (--pl->busy_walkers == 0 && pl->ndirs == 0)
+      pthread_cond_broadcast(&pl->dir_cv);
+    pthread_mutex_unlock(&pl->mu);
+  }
+}
+
+static void *walker_main(void *arg) {
+  Pipeline *pl = arg;
+  walk(pl, NULL);
+  pthread_mutex_lock(&pl->mu);
+  if (--pl->live_walkers == 0) {
+    pl->closed = 1;
+    pthread_cond_broadcast(&pl->not_empty);
+  }
+  pthread_mutex_unlock(&pl->mu);
+  return NULL;
+}
+
+static void *matcher_main(void *arg) {
+  Pipeline *pl = arg;
+  Matcher m;
+  int ok = matcher_init(&m, pl->re) == 0;
+  if (!ok)
+    fprintf(stderr, "pcre2: out of memory\n");
+  for (;;) {
+    pthread_mutex_lock(&pl->mu);
+    while (pl->count == 0 && !pl->closed)
+      pthread_cond_wait(&pl->not_empty, &pl->mu);
+    if (pl->count == 0) {
+      pthread_mutex_unlock(&pl->mu);
+      break;
+    }
+    char *path = pl->files[pl->head];
+    pl->head = (pl->head + 1) % QUEUE_CAP;
+    pl->count--;
+    pthread_cond_signal(&pl->not_full);
+    pthread_mutex_unlock(&pl->mu);
+
+    if (ok)
+      process_file(path, &m, pl->opt);
+    free(path);
+  }
+  matcher_free(&m);
+  return NULL;
+}
+
+void walk_and_process(const char *dir, const pcre2_code *re, const Options *o,
+                      int jobs) {
+  Pipeline pl = {.opt = o, .re = re};
+  pthread_mutex_init(&pl.mu, NULL);
+  pthread_cond_init(&pl.dir_cv, NULL);
+  pthread_cond_init(&pl.not_empty, NULL);
+  pthread_cond_init(&pl.not_full, NULL);
+  char *root = strdup(dir);
+  if (root)
+    push_dir(&pl, root);
+
+  // Listing is cheap next to matching: about one walker per four threads.
+  int walkers = jobs / 4 > 0 ? jobs / 4 : 1;
+  int matchers = jobs - walkers;
+  pthread_t *tids = NULL;
+  if (matchers > 0) {
+    pl.files = malloc(QUEUE_CAP * sizeof(char *));
+    tids = malloc((size_t)jobs * sizeof(pthread_t));
+  }
+
+  int nw = 0, nm = 0;
+  if (pl.files && tids) {
+    pl.live_walkers = walkers;
+    for (; nw < walkers; nw++)
+      if (pthread_create(&tids[nw], NULL, walker_main, &pl) != 0)
+        break;
+    pthread_mutex_lock(&pl.mu); // some may already have exited
+    pl.live_walkers -= walkers - nw;
+    if (nw > 0 && pl.live_walkers == 0) {
+      pl.closed = 1;
+      pthread_cond_broadcast(&pl.not_empty);
+    }
+    pthread_mutex_unlock(&pl.mu);
+    for (; nw > 0 && nm < matchers; nm++)
+      if (pthread_create(&tids[nw + nm], NULL, matcher_main, &pl) != 0)
+        break;
+  }
+
+  if (nw > 0) {
+    if (nm == 0)
+      matcher_main(&pl); // no matcher thread started: drain the queue here
+    for (int t = 0; t < nw + nm; t++)
+      pthread_join(tids[t], NULL);
+  } else {
+    // --jobs 1, or threads unavailable: walk and match right here
+    Matcher m;
+    if (matcher_init(&m, re) == 0)
+      walk(&pl, &m);
+    matcher_free(&m);
+  }
+
+  for (size_t i = 0; i < pl.ndirs; i++)
+    free(pl.dirs[i]);
+  free(pl.dirs);
+  free(pl.files);
+  free(tids);
+  pthread_cond_destroy(&pl.not_full);
+  pthread_cond_destroy(&pl.not_empty);
+  pthread_cond_destroy(&pl.dir_cv);
+  pthread_mutex_destroy(&pl.mu);
+}
+
 int main(int argc, char **argv) {
   char *dir = ".";
   char *pattern = NULL;
-  char *replace = NULL;
-  int recursive = 0;
-  int dry_run = 0;
+  Options o = {0};
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
 
   static struct option long_options[] = {{"pattern", required_argument, 0, 'p'},
                                          {"replace", required_argument, 0, 'r'},
                                          {"recursive", no_argument, 0, 'R'},
                                          {"dry-run", no_argument, 0, 'd'},
+                                         {"jobs", required_argument, 0, 'j'},
+                                         {"json", no_argument, 0, 'J'},
                                          {0, 0, 0, 0}};
 
   int opt;
-  while ((opt = getopt_long(argc, argv, "p:r:Rd", long_options, NULL)) != -1) {
+  while ((opt = getopt_long(argc, argv, "p:r:Rdj:J", long_options, NULL)) !=
+         -1) {
     switch (opt) {
     case 'p':
       pattern = optarg;
       break;
     case 'r':
-      replace = optarg;
+      o.replace = optarg;
       break;
     case 'R':
-      recursive = 1;
+      o.recursive = 1;
       break;
     case 'd':
-      dry_run = 1;
+      o.dry_run = 1;
+      break;
+    case 'j':
+      jobs = strtol(optarg, NULL, 10);
+      break;
+    case 'J':
+      o.json = 1;
       break;
     default:
       fprintf(stderr,
               "Usage: %s [dir] --pattern=regex --replace=str [--recursive] "
-              "[--dry-run]\n",
+              "[--dry-run] [--jobs=N] [--json]\n",
               argv[0]);
       exit(1);
     }
   }
   if (optind < argc)
     dir = argv[optind];
-  if (!pattern || !replace) {
+  if (!pattern || !o.replace) {
     fprintf(stderr, "Need pattern and replace\n");
     exit(1);
   }
+  if (jobs < 1)
+    jobs = 1;
 
   pcre2_code *re;
   PCRE2_SIZE erroffset;
   int errorcode;
-  re = pcre2_compile((PCRE2_SPTR)pattern, PCRE2_ZERO_TERMINATED, 0, &errorcode,
-                     &erroffset, NULL);
+  re = pcre2_compile((PCRE2_SPTR)pattern, PCRE2_ZERO_TERMINATED,
+                     PCRE2_MULTILINE, &errorcode, &erroffset, NULL);
   if (!re) {
     fprintf(stderr, "Regex compile failed\n");
     exit(1);
   }
+  pcre2_jit_compile(re, PCRE2_JIT_COMPLETE); // interpreter if JIT is missing
 
-  walk_and_process(dir, re, replace, recursive, dry_run);
+  walk_and_process(dir, re, &o, (int)jobs);
 
   pcre2_code_free(re);
   return 0;
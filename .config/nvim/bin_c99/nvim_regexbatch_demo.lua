@@ -14,3 +14,28 @@ end
 
 -- Command example
 vim.api.nvim_create_user_command('BatchRegex', function(opts) batch_regex(opts.args[1], opts.args[2], opts.args[3]) end, { nargs = 3 })
+
+-- Preview: --dry-run --json gives one record per match with its position
+-- and the text it would be replaced by
+local function preview_regex(dir, pattern, replace)
+    local cmd = { 'nvim-regexbatch', dir, '--pattern=' .. pattern, '--replace=' .. replace, '--recursive', '--dry-run', '--json' }
+    vim.fn.jobstart(cmd, {
+        stdout_buffered = true,
+        on_stdout = function(_, data)
+            local items = {}
+            for _, line in ipairs(data) do
+                if line ~= '' then
+                    local m = vim.json.decode(line)
+                    table.insert(items, {
+                        filename = m.file, lnum = m.line, col = m.col,
+                        text = m.text .. ' -> ' .. (m.replace or '?'),
+                    })
+                end
+            end
+            vim.fn.setqflist({}, 'r', { title = 'Regex Batch Preview', items = items })
+            vim.cmd('copen')
+        end,
+    })
+end
+
+vim.api.nvim_create_user_command('BatchRegexPreview', function(opts) preview_regex(opts.fargs[1], opts.fargs[2], opts.fargs[3]) end, { nargs = 3 })
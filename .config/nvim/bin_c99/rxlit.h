@@ -0,0 +1,209 @@
+#ifndef RXLIT_H
+#define RXLIT_H
+
+/*
+    rxlit.h — required-literal prefilter for POSIX EREs (single-header)
+
+    rxl_analyze() walks an extended regex and collects literal substrings
+    that every match must contain, e.g.
+
+        foo.*bar        -> "foo", "bar"
+        get_(user|id)s? -> "get_"
+        colou?r         -> "colo", "r"
+
+    rxl_match() then tells whether a buffer contains all of them, so callers
+    can skip regexec on lines that cannot match. Anything the analyzer does
+    not fully understand (top-level '|', odd quantifiers, ...) yields an
+    empty set, which means "no prefilter", never a false negative.
+*/
+
+#include "memscan.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  char **lits; /* longest first */
+  size_t *lens;
+  size_t n;
+} rxl_set;
+
+static inline void rxl_free(rxl_set *s) {
+  for (size_t i = 0; i < s->n; i++)
+    free(s->lits[i]);
+  free(s->lits);
+  free(s->lens);
+  *s = (rxl_set){0};
+}
+
+static inline int rxl_push(rxl_set *s, const char *run, size_t len) {
+  if (len == 0)
+    return 0;
+  char **nl = realloc(s->lits, (s->n + 1) * sizeof(char *));
+  if (!nl)
+    return -1;
+  s->lits = nl;
+  size_t *ns = realloc(s->lens, (s->n + 1) * sizeof(size_t));
+  if (!ns)
+    return -1;
+  s->lens = ns;
+  char *copy = malloc(len + 1);
+  if (!copy)
+    return -1;
+  memcpy(copy, run, len);
+  copy[len] = '\0';
+
+  /* insertion keeps the longest (usually rarest) literal first */
+  size_t i = s->n++;
+  while (i > 0 && s->lens[i - 1] < len) {
+    s->lits[i] = s->lits[i - 1];
+    s->lens[i] = s->lens[i - 1];
+    i--;
+  }
+  s->lits[i] = copy;
+  s->lens[i] = len;
+  return 0;
+}
+
+/* Skips a bracket expression; p points at '['. NULL if unterminated. */
+static inline const char *rxl_skip_bracket(const char *p) {
+  p++;
+  if (*p == '^')
+    p++;
+  if (*p == ']')
+    p++;
+  while (*p && *p != ']') {
+    if (*p == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.')) {
+      char d = p[1];
+      p += 2;
+      while (*p && !(*p == d && p[1] == ']'))
+        p++;
+      if (!*p)
+        return NULL;
+      p += 2;
+    } else {
+      p++;
+    }
+  }
+  return *p ? p + 1 : NULL;
+}
+
+/* Skips a parenthesised group; p points at '('. NULL if unbalanced. */
+static inline const char *rxl_skip_group(const char *p) {
+  int depth = 0;
+  while (*p) {
+    if (*p == '\\') {
+      if (!p[1])
+        return NULL;
+      p += 2;
+    } else if (*p == '[') {
+      if (!(p = rxl_skip_bracket(p)))
+        return NULL;
+    } else {
+      if (*p == '(')
+        depth++;
+      else if (*p == ')' && --depth == 0)
+        return p + 1;
+      p++;
+    }
+  }
+  return NULL;
+}
+
+/* Fills s with the literals every match of the ERE must contain.
+   Returns the number found (0 = no usable prefilter). */
+static inline size_t rxl_analyze(const char *pat, rxl_set *s) {
+  *s = (rxl_set){0};
+  char *run = malloc(strlen(pat) + 1);
+  size_t rlen = 0;
+  if (!run)
+    return 0;
+
+  const char *p = pat;
+  while (*p) {
+    int lit = 0;
+    char ch = 0;
+
+    /* atom */
+    switch (*p) {
+    case '|':
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+      goto give_up; /* alternation or a quantifier with nothing to bind */
+    case '\\':
+      if (!p[1])
+        goto give_up;
+      lit = !isalnum((unsigned char)p[1]); /* \w, \b, \1 ... are not */
+      ch = p[1];
+      p += 2;
+      break;
+    case '(':
+      if (!(p = rxl_skip_group(p)))
+        goto give_up;
+      break;
+    case '[':
+      if (!(p = rxl_skip_bracket(p)))
+        goto give_up;
+      break;
+    case '.':
+    case '^':
+    case '$':
+      p++;
+      break;
+    default:
+      lit = 1;
+      ch = *p++;
+    }
+
+    /* quantifier */
+    int required = 1, repeats = 0;
+    if (*p == '*' || *p == '?') {
+      required = 0;
+      p++;
+    } else if (*p == '+') {
+      repeats = 1;
+      p++;
+    } else if (*p == '{') {
+      if (!isdigit((unsigned char)p[1]))
+        goto give_up;
+      required = atoi(p + 1) > 0;
+      repeats = 1;
+      const char *close = strchr(p, '}');
+      if (!close)
+        goto give_up;
+      p = close + 1;
+    }
+    if (*p == '*' || *p == '+' || *p == '?' || *p == '{')
+      goto give_up;
+
+    if (lit && required) {
+      run[rlen++] = ch;
+      if (!repeats)
+        continue;
+    }
+    if (rxl_push(s, run, rlen) != 0)
+      goto give_up;
+    rlen = 0;
+  }
+  if (rxl_push(s, run, rlen) != 0)
+    goto give_up;
+  free(run);
+  return s->n;
+
+give_up:
+  free(run);
+  rxl_free(s);
+  return 0;
+}
+
+/* 1 if buf[0..n) contains every literal of s (always 1 for an empty set). */
+static inline int rxl_match(const rxl_set *s, const char *buf, size_t n) {
+  for (size_t i = 0; i < s->n; i++)
+    if (!ms_find(buf, n, s->lits[i], s->lens[i]))
+      return 0;
+  return 1;
+}
+
+#endif // RXLIT_H
@@ -1,44 +1,40 @@
-
 // sort-lite.c : stable sorter
 // build: cc sort-lite.c -O2 -o sort-lite
+//
+// stdin is read in bulk into a str_arena.h buffer and split in place; the
+// sort moves 24-byte records, never the text. Equal lines keep input order.
 
-#include <ctype.h>
+#include "str_arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct {
-  char *line;
-  int index;
-} Item;
+static const char *text; // arena text, for cmp
 
 int cmp(const void *a, const void *b) {
-  const Item *x = a, *y = b;
-  return strcmp(x->line, y->line);
+  const sa_rec *x = a, *y = b;
+  uint32_t n = x->len < y->len ? x->len : y->len;
+  int c = memcmp(text + x->off, text + y->off, n);
+  if (c == 0 && x->len != y->len)
+    c = x->len < y->len ? -1 : 1;
+  if (c == 0) // offsets follow input order: this makes qsort stable
+    c = (x->off > y->off) - (x->off < y->off);
+  return c;
 }
 
 int main() {
-  Item *items = NULL;
-  size_t cap = 0, len = 0;
-  char buf[4096];
-
-  while (fgets(buf, sizeof buf, stdin)) {
-    if (len == cap) {
-      cap = cap ? cap * 2 : 128;
-      items = realloc(items, cap * sizeof(Item));
-    }
-    items[len].line = strdup(buf);
-    items[len].index = len;
-    len++;
-  }
+  sa_arena in;
+  if (sa_read_lines(&in, STDIN_FILENO, 0) != 0)
+    perror("sort-lite: stdin");
+  text = in.text;
 
-  qsort(items, len, sizeof(Item), cmp);
+  qsort(in.recs, in.n, sizeof(sa_rec), cmp);
 
-  for (size_t i = 0; i < len; i++) {
-    printf("%s", items[i].line);
-    free(items[i].line);
+  for (size_t i = 0; i < in.n; i++) {
+    fwrite(sa_str(&in, &in.recs[i]), 1, in.recs[i].len, stdout);
+    putchar('\n');
   }
 
-  free(items);
+  sa_free(&in);
   return 0;
 }
@@ -0,0 +1,192 @@
+#ifndef STR_ARENA_H
+#define STR_ARENA_H
+
+/*
+    str_arena.h — line storage for filters that read a list on stdin
+    (single-header)
+
+    All input text lives in one buffer that grows in large steps; lines are
+    split in place ('\n' becomes '\0') and described by compact records:
+
+        sa_arena a;
+        if (sa_read_lines(&a, STDIN_FILENO, 0) != 0) ...
+        for (size_t i = 0; i < a.n; i++)
+          use(sa_str(&a, &a.recs[i]), a.recs[i].len);
+        sa_free(&a);
+
+    There is no allocation per line, and walking the records in order walks
+    the text in order. Records carry a score slot for rankers; offsets grow
+    with input order, so they double as a stable tie-break.
+
+    sa_char_mask() summarises which characters a string contains in 64
+    bits, case-folded like tolower(); a candidate can only match a query
+    subsequence if (cand_mask & query_mask) == query_mask. With SA_MASKS,
+    sa_read_lines() stores each line's mask in its record while the line
+    is still in cache, so filters reject a line with one AND on every
+    query instead of another pass over its bytes.
+
+    All functions are static inline; just include the header.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define SA_READ_CHUNK (1u << 20) /* minimum free space per read(2) */
+
+#define SA_MASKS 1u /* sa_read_lines(): fill sa_rec.mask */
+
+typedef struct {
+  uint64_t off;  /* into sa_arena.text */
+  uint64_t mask; /* sa_char_mask() of the line, with SA_MASKS (else 0) */
+  uint32_t len;  /* without the terminator */
+  int32_t score;
+} sa_rec;
+
+typedef struct {
+  char *text;
+  size_t tlen, tcap;
+  sa_rec *recs;
+  size_t n, cap;
+} sa_arena;
+
+static inline const char *sa_str(const sa_arena *a, const sa_rec *r) {
+  return a->text + r->off;
+}
+
+static inline void sa_free(sa_arena *a) {
+  free(a->text);
+  free(a->recs);
+  *a = (sa_arena){0};
+}
+
+/* Appends everything readable from fd to the text buffer. */
+static inline int sa_slurp(sa_arena *a, int fd) {
+  for (;;) {
+    if (a->tcap - a->tlen < SA_READ_CHUNK) {
+      size_t nc = a->tcap ? a->tcap * 2 : 4 * SA_READ_CHUNK;
+      char *nt = realloc(a->text, nc);
+      if (!nt)
+        return -1;
+      a->text = nt;
+      a->tcap = nc;
+    }
+    /* keep one byte for the terminator of an unterminated last line */
+    ssize_t r = read(fd, a->text + a->tlen, a->tcap - a->tlen - 1);
+    if (r < 0)
+      return -1;
+    if (r == 0)
+      return 0;
+    a->tlen += (size_t)r;
+  }
+}
+
+static inline int sa_push(sa_arena *a, size_t off, size_t len) {
+  if (a->n == a->cap) {
+    size_t nc = a->cap ? a->cap * 2 : 4096;
+    sa_rec *nr = realloc(a->recs, nc * sizeof(sa_rec));
+    if (!nr)
+      return -1;
+    a->recs = nr;
+    a->cap = nc;
+  }
+  a->recs[a->n++] = (sa_rec){off, 0, (uint32_t)len, 0};
+  return 0;
+}
+
+/* ============================
+      CHARACTER MASKS
+   ============================ */
+
+/* Bit of byte c: (group of the high nibble) * 16 + low nibble. 0x4_/0x6_
+   and 0x5_/0x7_ share a group, which folds ASCII case; everything outside
+   0x20..0x7f lands on the punctuation group. Collisions only let more
+   candidates through, never fewer. */
+static const uint8_t sa_hi_group[16] = {2, 2, 2, 3, 0, 1, 0, 1,
+                                        2, 2, 2, 2, 2, 2, 2, 2};
+
+static inline uint64_t sa_char_bit(unsigned char c) {
+  return 1ull << (sa_hi_group[c >> 4] * 16 + (c & 15));
+}
+
+static inline uint64_t sa_char_mask(const char *s, size_t n) {
+  uint64_t m = 0;
+  size_t i = 0;
+#if defined(__AVX2__)
+  if (n >= 32) {
+    /* Per byte: mask byte g = bit idx / 8, bit = 1 << (idx % 8). One OR
+       accumulator per g; reduced to a byte each at the end. */
+    const __m256i lo_nib = _mm256_set1_epi8(15), one = _mm256_set1_epi8(1);
+    const __m256i grp2 = _mm256_setr_epi8( /* 2 * sa_hi_group */
+        4, 4, 4, 6, 0, 2, 0, 2, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 6, 0, 2, 0,
+        2, 4, 4, 4, 4, 4, 4, 4, 4);
+    const __m256i bitv = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+        8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i acc[8];
+    for (int g = 0; g < 8; g++)
+      acc[g] = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+      __m256i lo = _mm256_and_si256(v, lo_nib);
+      __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lo_nib);
+      __m256i grp = _mm256_add_epi8(
+          _mm256_shuffle_epi8(grp2, hi),
+          _mm256_and_si256(_mm256_srli_epi16(lo, 3), one));
+      __m256i bit = _mm256_shuffle_epi8(bitv, lo);
+      for (int g = 0; g < 8; g++)
+        acc[g] = _mm256_or_si256(
+            acc[g], _mm256_and_si256(
+                        _mm256_cmpeq_epi8(grp, _mm256_set1_epi8((char)g)), bit));
+    }
+    for (int g = 0; g < 8; g++) {
+      __m128i x = _mm_or_si128(_mm256_castsi256_si128(acc[g]),
+                               _mm256_extracti128_si256(acc[g], 1));
+      uint64_t r = (uint64_t)_mm_cvtsi128_si64(_mm_or_si128(
+          x, _mm_unpackhi_epi64(x, x)));
+      r |= r >> 32;
+      r |= r >> 16;
+      r |= r >> 8;
+      m |= (r & 0xff) << (8 * g);
+    }
+  }
+#endif
+  for (; i < n; i++)
+    m |= sa_char_bit((unsigned char)s[i]);
+  return m;
+}
+
+/* ============================
+      LINE SPLITTING
+   ============================ */
+
+/* Reads fd to EOF and splits it into NUL-terminated lines. A trailing
+   newline does not start an extra line. flags: SA_MASKS or 0. Returns 0,
+   or -1 on a read error or out of memory (lines read so far stay
+   usable). */
+static inline int sa_read_lines(sa_arena *a, int fd, unsigned flags) {
+  *a = (sa_arena){0};
+  int rc = sa_slurp(a, fd);
+  if (!a->text)
+    return rc;
+  char *p = a->text, *end = a->text + a->tlen;
+  while (p < end) {
+    char *nl = memchr(p, '\n', (size_t)(end - p));
+    if (!nl)
+      nl = end; /* sa_slurp left room for this '\0' */
+    *nl = '\0';
+    if (sa_push(a, (size_t)(p - a->text), (size_t)(nl - p)) != 0)
+      return -1;
+    if (flags & SA_MASKS)
+      a->recs[a->n - 1].mask = sa_char_mask(p, (size_t)(nl - p));
+    p = nl + 1;
+  }
+  return rc;
+}
+
+#endif // STR_ARENA_H